@@ -0,0 +1,128 @@
+#ifndef ASYNC_ASSET_LOADER_H
+#define ASYNC_ASSET_LOADER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "stb_image.h"
+
+// Pixels of a decoded image file. data is owned by whoever collected the image and has to be given back with AsyncAssetLoader::freeImage.
+struct DecodedImage {
+    // Whatever the requester passed along with the request. TextureCache passes its own request id (++lastRequest) rather than the
+    // GL texture name, since GL can hand out a released name again while the old decode is still running.
+    unsigned int tag;
+    std::string path;
+    unsigned char* data;
+    int width, height, channels;
+};
+
+/* Decodes image files on a pool of worker threads. This class never touches GL, since only the thread that owns the context may
+*  upload anything. Instead the GL thread calls collect() once per frame and uploads whatever finished since the last call.
+*  That way startup time scales with the number of cores instead of the number of images.
+*/
+class AsyncAssetLoader
+{
+private:
+    struct Job {
+        unsigned int tag;
+        std::string path;
+        bool flipVertically;
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::deque<Job> jobs;
+    std::vector<DecodedImage> finished;
+    // Requests that have not been collected yet (queued, being decoded or waiting in finished).
+    unsigned int outstanding{};
+    bool stopping{};
+
+    void workerLoop() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping)
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            // The flip flag has to be thread local here, the global stbi_set_flip_vertically_on_load would race with the other workers.
+            DecodedImage image{};
+            image.tag = job.tag;
+            image.path = job.path;
+            stbi_set_flip_vertically_on_load_thread(job.flipVertically);
+            image.data = stbi_load(job.path.c_str(), &image.width, &image.height, &image.channels, 0);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.push_back(std::move(image));
+        }
+    }
+
+public:
+    // 0 threads means one per hardware thread, minus the main thread which is busy with GL.
+    AsyncAssetLoader(unsigned int threadCount = 0) {
+        if (threadCount == 0) {
+            unsigned int hw = std::thread::hardware_concurrency();
+            threadCount = hw > 1 ? hw - 1 : 1;
+        }
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back(&AsyncAssetLoader::workerLoop, this);
+    }
+
+    ~AsyncAssetLoader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobAvailable.notify_all();
+        for (std::thread& t : workers)
+            t.join();
+        for (DecodedImage& image : finished)
+            freeImage(image);
+    }
+
+    AsyncAssetLoader(const AsyncAssetLoader&) = delete;
+    AsyncAssetLoader& operator=(const AsyncAssetLoader&) = delete;
+
+    void request(const std::string& path, bool flipVertically, unsigned int tag) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(Job{ tag, path, flipVertically });
+            outstanding++;
+        }
+        jobAvailable.notify_one();
+    }
+
+    // Moves every image that finished decoding into out. Never blocks on a decode, only on the queue lock.
+    void collect(std::vector<DecodedImage>& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        outstanding -= (unsigned int)finished.size();
+        for (DecodedImage& image : finished)
+            out.push_back(std::move(image));
+        finished.clear();
+    }
+
+    // True while there are requests that haven't been handed out by collect() yet.
+    bool busy() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return outstanding > 0;
+    }
+
+    unsigned int threadCount() const {
+        return (unsigned int)workers.size();
+    }
+
+    static void freeImage(DecodedImage& image) {
+        stbi_image_free(image.data);
+        image.data = nullptr;
+    }
+};
+
+#endif
@@ -0,0 +1,714 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "AsyncAssetLoader.h"
+#include "stb_image.h"
+#include "CubeWorld.h"
+#include "CubeBVH.h"
+#include "CubeGrid.h"
+#include "CubeRaycast.h"
+#include "CubeIntegrate.h"
+#include "CubeOcclusion.h"
+#include "Simulation.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <set>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Benchmarks of the parts that don't need a GL context, main.cpp runs them with --bench <name> before it even opens a window, so they
+*  work on machines without a GPU. --cubes sets the size of each, 0 picks the size the numbers in the commit history were taken with.
+*  Every benchmark prints its results as lines starting with "Bench <name>:". The ones drawing something are in RenderBenchmarks.h.
+*/
+
+// Seconds since start.
+inline double benchSeconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* --bench textures: decodes images images (256 when 0) once one after another on this thread, the way textures were loaded before
+*  AsyncAssetLoader, and once through an AsyncAssetLoader, collecting them as they finish like TextureCache::update does. The images
+*  are copies of the three cube textures under new names in a temporary directory, so every decode reads its own file.
+*/
+inline int benchTextures(unsigned int images) {
+    if (images == 0)
+        images = 256;
+    const char* sources[] = { "diamond.jpg", "diamondSpec.jpg", "diamondEmit.jpg" };
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "cube_bench_textures";
+    std::filesystem::create_directories(dir);
+    std::vector<std::string> paths;
+    for (unsigned int i = 0; i < images; i++) {
+        std::filesystem::path path = dir / (std::to_string(i) + ".jpg");
+        std::filesystem::copy_file(sources[i % 3], path, std::filesystem::copy_options::overwrite_existing);
+        paths.push_back(path.string());
+    }
+
+    size_t serialBytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string& path : paths) {
+        int width, height, channels;
+        stbi_set_flip_vertically_on_load(true);
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 0);
+        if (data)
+            serialBytes += (size_t)width * height * channels;
+        stbi_image_free(data);
+    }
+    double serialSeconds = benchSeconds(start);
+
+    size_t parallelBytes = 0;
+    unsigned int threads;
+    start = std::chrono::steady_clock::now();
+    {
+        AsyncAssetLoader loader;
+        threads = loader.threadCount();
+        for (unsigned int i = 0; i < images; i++)
+            loader.request(paths[i], true, i);
+        std::vector<DecodedImage> decoded;
+        while (loader.busy()) {
+            decoded.clear();
+            loader.collect(decoded);
+            for (DecodedImage& image : decoded) {
+                if (image.data)
+                    parallelBytes += (size_t)image.width * image.height * image.channels;
+                AsyncAssetLoader::freeImage(image);
+            }
+            std::this_thread::yield();
+        }
+    }
+    double parallelSeconds = benchSeconds(start);
+    std::filesystem::remove_all(dir);
+
+    std::cout << "Bench textures: " << images << " images, serial " << serialSeconds * 1000.0 << " ms, " << threads << " loader threads "
+        << parallelSeconds * 1000.0 << " ms (" << serialSeconds / parallelSeconds << "x)" << std::endl;
+    if (serialBytes != parallelBytes) {
+        std::cout << "Bench textures: decoded " << parallelBytes << " bytes in parallel but " << serialBytes << " serially" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/* --bench picking: cubes cubes (1000000 when 0) scattered at random through a 200 x 50 x 200 box, about as dense as a pile with
+*  gaps, and rays cast into them through CubeBVH::raycast, the query behind the crosshair. Three sets of rays: random ones starting
+*  inside the box, random ones from above looking down into it, and a camera turning slowly while looking at it, one ray per frame
+*  like the crosshair. Random rays mostly miss the cache, the camera's rays walk the same part of the tree frame after frame.
+*  The first CHECKED rays of each set are compared with testing every cube with raycastCubes. Every ray is also cast through
+*  CubeGrid::raycast without a distance limit, which has to give the same hit as the BVH and end rays that miss.
+*/
+inline int benchPicking(unsigned int cubes) {
+    if (cubes == 0)
+        cubes = 1000000;
+    const unsigned int RAYS = 100000, CHECKED = 100;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    CubeWorld world;
+    world.reserve(cubes);
+    // Brute force needs the centers as padded x/y/z arrays, see RAYCAST_BATCH.
+    std::vector<float> x(cubes + RAYCAST_BATCH), y(cubes + RAYCAST_BATCH), z(cubes + RAYCAST_BATCH);
+    for (unsigned int i = 0; i < cubes; i++) {
+        glm::vec3 position(unit(random) * 200.0f - 100.0f, unit(random) * 50.0f, unit(random) * 200.0f - 100.0f);
+        world.spawn(position, "cube", true);
+        x[i] = position.x;
+        y[i] = position.y;
+        z[i] = position.z;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    CubeBVH bvh;
+    bvh.build(world);
+    std::cout << "Bench picking: " << cubes << " cubes, BVH built in " << benchSeconds(start) * 1000.0 << " ms" << std::endl;
+    start = std::chrono::steady_clock::now();
+    CubeGrid grid;
+    grid.build(world);
+    std::cout << "Bench picking: grid built in " << benchSeconds(start) * 1000.0 << " ms" << std::endl;
+
+    std::vector<glm::vec3> origins(RAYS), dirs(RAYS);
+    unsigned int mismatches = 0, gridMismatches = 0;
+    auto castRays = [&](const char* label) {
+        unsigned int hits = 0;
+        auto castStart = std::chrono::steady_clock::now();
+        for (unsigned int r = 0; r < RAYS; r++) {
+            if (bvh.raycast(origins[r], dirs[r]).cube)
+                hits++;
+        }
+        double seconds = benchSeconds(castStart);
+
+        // The grid with no limit on the distance, every ray that misses has to end where it leaves the cubes.
+        auto gridRaycast = [&](unsigned int r) {
+            float maxT = r % 2 == 0 ? std::numeric_limits<float>::max() : std::numeric_limits<float>::infinity();
+            return grid.raycast(origins[r], dirs[r], maxT);
+        };
+        unsigned int gridHits = 0;
+        castStart = std::chrono::steady_clock::now();
+        for (unsigned int r = 0; r < RAYS; r++) {
+            if (gridRaycast(r).cube)
+                gridHits++;
+        }
+        double gridSeconds = benchSeconds(castStart);
+        for (unsigned int r = 0; r < RAYS; r++) {
+            CubeGrid::Hit hit = gridRaycast(r);
+            CubeBVH::Hit expected = bvh.raycast(origins[r], dirs[r]);
+            if (hit.t != expected.t || !hit.cube != !expected.cube)
+                gridMismatches++;
+        }
+
+        castStart = std::chrono::steady_clock::now();
+        for (unsigned int r = 0; r < CHECKED; r++) {
+            CubeRayHit expected = raycastCubes(x.data(), y.data(), z.data(), (int)cubes, origins[r], rayInverseDirection(dirs[r]),
+                std::numeric_limits<float>::max());
+            CubeBVH::Hit hit = bvh.raycast(origins[r], dirs[r]);
+            // Two cubes hit at exactly the same t may come out in either order.
+            if (hit.t != expected.t || (expected.index < 0) != !hit.cube)
+                mismatches++;
+        }
+        double bruteSeconds = benchSeconds(castStart);
+        std::cout << "Bench picking: " << label << ", " << RAYS << " rays (" << hits << " hit), BVH " << seconds * 1e6 / RAYS
+            << " us per ray, grid " << gridSeconds * 1e6 / RAYS << " us per ray (" << gridHits << " hit), testing every cube " << bruteSeconds * 1e6 / CHECKED
+            << " us per ray" << std::endl;
+    };
+
+    for (unsigned int r = 0; r < RAYS; r++) {
+        origins[r] = glm::vec3(unit(random) * 200.0f - 100.0f, unit(random) * 50.0f, unit(random) * 200.0f - 100.0f);
+        dirs[r] = glm::normalize(glm::vec3(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f));
+    }
+    castRays("random rays inside");
+    for (unsigned int r = 0; r < RAYS; r++) {
+        origins[r] = glm::vec3(unit(random) * 200.0f - 100.0f, 60.0f, unit(random) * 200.0f - 100.0f);
+        dirs[r] = glm::normalize(glm::vec3(unit(random) - 0.5f, -0.2f - unit(random), unit(random) - 0.5f));
+    }
+    castRays("random rays from above");
+    // Half a turn over all the rays, a bit over 0.1 degrees per frame.
+    for (unsigned int r = 0; r < RAYS; r++) {
+        float yaw = 3.14159265f * r / RAYS;
+        origins[r] = glm::vec3(0.0f, 60.0f, 0.0f);
+        dirs[r] = glm::normalize(glm::vec3(std::cos(yaw), -0.5f, std::sin(yaw)));
+    }
+    castRays("turning camera");
+
+    std::cout << "Bench picking: " << mismatches << " of " << 3 * CHECKED << " checked rays differ, the grid differs from the BVH on "
+        << gridMismatches << " of " << 3 * RAYS << std::endl;
+    return mismatches == 0 && gridMismatches == 0 ? 0 : 1;
+}
+
+/* Cube::isCubeTargeted, the crosshair test every cube ran before CubeRaycast.h, kept as the reference raycastCubes is checked against.
+*  Returns the t at which the ray enters the cube through the face turned towards it, or -1 if it misses. Unlike the slab test it wants
+*  the ray strictly inside that face, so a ray running exactly along an edge misses.
+*/
+inline float referenceTargetedT(const glm::vec3& Position, const glm::vec3& cameraPos, const glm::vec3& cameraFront) {
+    for (int axis = 0; axis < 3; ++axis) {
+        float dir = cameraFront[axis];
+        if (dir == 0) continue;                         // Front is prallel in to this plane, skip to prevent Divide by Zero.
+
+        float faceOffset = (dir > 0.0f) ? -0.5f : 0.5f; // Check whether nearer or farther cube face is closer to camera so we only check one plane.
+        float planePos = Position[axis] + faceOffset;
+        float t = (planePos - cameraPos[axis]) / dir;   // Determine scalar at which the front vector intersects the cube plane.
+
+        if (t < 0.0f) continue;                         // Scalar is negative, so cube is behind camera.
+
+        // Compute intersection point coordinates on the other two axes.
+        int a1 = (axis + 1) % 3;
+        int a2 = (axis + 2) % 3;
+        float interA1 = cameraPos[a1] + t * cameraFront[a1];
+        float interA2 = cameraPos[a2] + t * cameraFront[a2];
+
+        // Check whether the intersections are within the cube face.
+        if (interA1 > (Position[a1] - 0.5f) && interA1 < (Position[a1] + 0.5) &&
+            interA2 >(Position[a2] - 0.5f) && interA2 < (Position[a2] + 0.5)) {
+            return t;
+        }
+    }
+    return -1.0f;
+}
+
+/* --bench raycast: randomized equivalence check of raycastCubes (whichever of AVX2, SSE2 or scalar this build uses, build once with
+*  and once without AVX2 enabled to check both) against raycastCubesScalar and against referenceTargetedT, then the time of one ray
+*  against cubes cubes (1000000 when 0). The cases mix:
+*  - cube counts from 1 to 67, mostly not a multiple of RAYCAST_BATCH, so the masked tail is exercised
+*  - rays with one or two direction components exactly 0
+*  - cubes listed twice and cubes on integer positions, so several cubes are entered at exactly the same t
+*  - a maxT that cuts some hits off
+*  raycastCubes has to match the scalar version exactly, index and t. The reference divides where the slab test multiplies by 1 / dir,
+*  so its t may differ in the last bits, and it misses rays that run exactly along a face's edge. Differences where the hit lies on an
+*  edge of the face (within 1e-4) are counted separately and don't fail the check.
+*/
+inline int benchRaycast(unsigned int cubes) {
+    if (cubes == 0)
+        cubes = 1000000;
+    const unsigned int CASES = 20000, MAX_COUNT = 67;
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> x(MAX_COUNT + RAYCAST_BATCH), y(MAX_COUNT + RAYCAST_BATCH), z(MAX_COUNT + RAYCAST_BATCH);
+    unsigned int simdMismatches = 0, referenceMismatches = 0, edgeMismatches = 0, hits = 0, ties = 0;
+
+    // True if the ray enters the cube at center at t right on an edge of the face it enters through.
+    auto onEdge = [](const glm::vec3& center, const glm::vec3& origin, const glm::vec3& dir, float t) {
+        glm::vec3 p = origin + dir * t;
+        int inside = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            if (std::abs(std::abs(p[axis] - center[axis]) - 0.5f) > 1e-4f)
+                inside++;
+        }
+        return inside > 0 && inside < 2;
+    };
+
+    for (unsigned int c = 0; c < CASES; c++) {
+        int count = 1 + (int)(random() % MAX_COUNT);
+        bool grid = c % 2 == 1;
+        for (int i = 0; i < count; i++) {
+            // Every fifth cube repeats an earlier one.
+            int same = i > 0 && random() % 5 == 0 ? (int)(random() % i) : -1;
+            glm::vec3 p = same >= 0 ? glm::vec3(x[same], y[same], z[same])
+                : glm::vec3(unit(random), unit(random), unit(random)) * 12.0f - glm::vec3(6.0f);
+            if (grid && same < 0)
+                p = glm::floor(p);
+            x[i] = p.x;
+            y[i] = p.y;
+            z[i] = p.z;
+        }
+        // Garbage past count, it has to be masked out.
+        for (int i = count; i < count + RAYCAST_BATCH; i++)
+            x[i] = y[i] = z[i] = 0.0f;
+
+        glm::vec3 origin = glm::vec3(unit(random), unit(random), unit(random)) * 16.0f - glm::vec3(8.0f);
+        glm::vec3 dir(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f);
+        int zeros = c % 4 == 0 ? 1 : (c % 4 == 1 ? 2 : 0);
+        for (int k = 0; k < zeros; k++)
+            dir[random() % 3] = 0.0f;
+        if (glm::dot(dir, dir) == 0.0f)
+            dir = glm::vec3(0.0f, 0.0f, -1.0f);
+        dir = glm::normalize(dir);
+        float maxT = c % 3 == 0 ? unit(random) * 10.0f : std::numeric_limits<float>::max();
+        glm::vec3 invDir = rayInverseDirection(dir);
+
+        CubeRayHit simd = raycastCubes(x.data(), y.data(), z.data(), count, origin, invDir, maxT);
+        CubeRayHit scalar = raycastCubesScalar(x.data(), y.data(), z.data(), count, origin, invDir, maxT);
+        if (simd.index != scalar.index || simd.t != scalar.t)
+            simdMismatches++;
+
+        // Closest cube by the old test, lower index on equal t like raycastCubes.
+        CubeRayHit reference;
+        int tied = 0;
+        for (int i = 0; i < count; i++) {
+            float t = referenceTargetedT(glm::vec3(x[i], y[i], z[i]), origin, dir);
+            if (t < 0.0f || t >= maxT)
+                continue;
+            if (t == reference.t)
+                tied++;
+            if (t < reference.t) {
+                reference.t = t;
+                reference.index = i;
+                tied = 0;
+            }
+        }
+        if (reference.index >= 0) {
+            hits++;
+            ties += tied > 0 ? 1 : 0;
+        }
+        bool same = reference.index == scalar.index &&
+            (reference.index < 0 || std::abs(reference.t - scalar.t) <= 1e-5f * std::max(1.0f, reference.t));
+        if (!same) {
+            int edgeIndex = scalar.index >= 0 ? scalar.index : reference.index;
+            float edgeT = scalar.index >= 0 ? scalar.t : reference.t;
+            bool edge = onEdge(glm::vec3(x[edgeIndex], y[edgeIndex], z[edgeIndex]), origin, dir, edgeT);
+            if (reference.index >= 0 && scalar.index >= 0 && !edge)
+                edge = onEdge(glm::vec3(x[reference.index], y[reference.index], z[reference.index]), origin, dir, reference.t);
+            if (edge)
+                edgeMismatches++;
+            else
+                referenceMismatches++;
+        }
+    }
+    std::cout << "Bench raycast: " << CASES << " random cases (" << hits << " hit, " << ties << " with a tie for the closest cube), " << CUBE_SIMD_NAME
+        << " vs scalar: " << simdMismatches << " differ, scalar vs the old isCubeTargeted: " << referenceMismatches << " differ, "
+        << edgeMismatches << " more on a face edge" << std::endl;
+
+    // One ray after another against all cubes, spread through a box the rays start in so most lanes do real work.
+    const unsigned int RAYS = 50;
+    x.assign(cubes + RAYCAST_BATCH, 0.0f);
+    y.assign(cubes + RAYCAST_BATCH, 0.0f);
+    z.assign(cubes + RAYCAST_BATCH, 0.0f);
+    for (unsigned int i = 0; i < cubes; i++) {
+        x[i] = unit(random) * 200.0f - 100.0f;
+        y[i] = unit(random) * 50.0f;
+        z[i] = unit(random) * 200.0f - 100.0f;
+    }
+    std::vector<glm::vec3> origins(RAYS), invDirs(RAYS);
+    for (unsigned int r = 0; r < RAYS; r++) {
+        origins[r] = glm::vec3(unit(random) * 200.0f - 100.0f, unit(random) * 50.0f, unit(random) * 200.0f - 100.0f);
+        invDirs[r] = rayInverseDirection(glm::normalize(glm::vec3(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f)));
+    }
+    int checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int r = 0; r < RAYS; r++)
+        checksum += raycastCubes(x.data(), y.data(), z.data(), (int)cubes, origins[r], invDirs[r], std::numeric_limits<float>::max()).index;
+    double simdSeconds = benchSeconds(start);
+    start = std::chrono::steady_clock::now();
+    for (unsigned int r = 0; r < RAYS; r++)
+        checksum -= raycastCubesScalar(x.data(), y.data(), z.data(), (int)cubes, origins[r], invDirs[r], std::numeric_limits<float>::max()).index;
+    double scalarSeconds = benchSeconds(start);
+    std::cout << "Bench raycast: one ray against " << cubes << " cubes, " << CUBE_SIMD_NAME << " " << simdSeconds * 1000.0 / RAYS << " ms, scalar "
+        << scalarSeconds * 1000.0 / RAYS << " ms (" << scalarSeconds / simdSeconds << "x)" << (checksum != 0 ? ", results differ" : "") << std::endl;
+
+    return simdMismatches == 0 && referenceMismatches == 0 && checksum == 0 ? 0 : 1;
+}
+
+/* --bench settle: drops cubes cubes (10000 when 0) into the scene like --cubes does and steps the simulation with nobody touching
+*  anything until every cube fell asleep, or a minute of simulated time passed. Prints how much simulated time the pile needed to
+*  settle, how long the steps took in real time, and the most contacts and awake cubes a single step had.
+*/
+inline int benchSettle(unsigned int cubes) {
+    if (cubes == 0)
+        cubes = 10000;
+    const float MAX_TIME = 60.0f;
+    JobSystem jobs;
+    Simulation simulation(&jobs);
+    simulation.spawnScene(cubes);
+    SimulationInput input;
+    unsigned int steps = 0, maxContacts = 0, maxAwake = 0;
+    double slowestStep = 0.0;
+
+    auto start = std::chrono::steady_clock::now();
+    while (!simulation.movingCubes.empty() && steps * Simulation::PHYSICS_STEP < MAX_TIME) {
+        auto stepStart = std::chrono::steady_clock::now();
+        input.time = steps * Simulation::PHYSICS_STEP;
+        simulation.frame(Simulation::PHYSICS_STEP, input);
+        slowestStep = std::max(slowestStep, benchSeconds(stepStart));
+        maxContacts = std::max(maxContacts, simulation.solver.contactCount);
+        maxAwake = std::max(maxAwake, simulation.solver.awakeCount);
+        steps++;
+    }
+    double seconds = benchSeconds(start);
+    bool settled = simulation.movingCubes.empty();
+    std::cout << "Bench settle: " << cubes << " cubes " << (settled ? "asleep after " : "still awake after ") << steps * Simulation::PHYSICS_STEP
+        << " s simulated (" << steps << " steps) in " << seconds << " s, " << seconds * 1000.0 / std::max(steps, 1u) << " ms per step on average, "
+        << slowestStep * 1000.0 << " ms the slowest, at most " << maxAwake << " awake cubes and " << maxContacts << " contacts" << std::endl;
+    if (!settled)
+        std::cout << "Bench settle: " << simulation.movingCubes.size() << " cubes never fell asleep" << std::endl;
+    return settled ? 0 : 1;
+}
+
+/* --bench integrate: gravity and movement for one physics step of cubes awake cubes, on one thread, done three ways:
+*  - per cube through a std::set<CubeHandle> of the awake cubes, looking each one up in the world, the way CubeSolver did before it
+*    had packed arrays
+*  - the way CubeSolver does it now, copying the cubes of a CubeActiveList into packed arrays, running accelerateCubes and moveCubes
+*    over them and copying the results back
+*  - just the two kernels over arrays that are already packed
+*  With cubes 0 it runs for 1000, 100000 and 1000000 cubes. Prints the time per step and per cube.
+*/
+inline int benchIntegrate(unsigned int cubes) {
+    std::vector<unsigned int> sizes = { cubes };
+    if (cubes == 0)
+        sizes = { 1000, 100000, 1000000 };
+    const float dt = Simulation::PHYSICS_STEP;
+    for (unsigned int n : sizes) {
+        CubeWorld world;
+        world.reserve(n);
+        std::set<CubeHandle> movingSet;
+        CubeActiveList moving;
+        for (unsigned int i = 0; i < n; i++) {
+            CubeHandle h = world.spawn(glm::vec3((float)(i % 1000), 100.0f + (float)(i / 1000), 0.0f), "cube", true);
+            movingSet.insert(h);
+            moving.insert(h);
+        }
+        // Enough steps to take about the same time for every size.
+        unsigned int steps = std::max(20000000u / n, 1u);
+        std::vector<float> x, y, z, vx, vy, vz;
+        auto report = [&](const char* label, double seconds) {
+            std::cout << "Bench integrate: " << n << " cubes, " << label << ", " << seconds * 1000.0 / steps << " ms per step, "
+                << seconds * 1e9 / ((double)steps * n) << " ns per cube" << std::endl;
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int step = 0; step < steps; step++) {
+            for (CubeHandle h : movingSet) {
+                uint32_t i = world.indexOf(h);
+                world.prevX[i] = world.posX[i];
+                world.prevY[i] = world.posY[i];
+                world.prevZ[i] = world.posZ[i];
+                world.velY[i] += -dt * CUBE_GRAVITY;
+            }
+            for (CubeHandle h : movingSet) {
+                uint32_t i = world.indexOf(h);
+                world.posX[i] += world.velX[i] * dt;
+                world.posY[i] += world.velY[i] * dt;
+                world.posZ[i] += world.velZ[i] * dt;
+            }
+        }
+        report("std::set, per cube", benchSeconds(start));
+        float perCubeY = world.posY[n - 1];
+
+        // Same start, so both have to end up at the same place.
+        for (unsigned int i = 0; i < n; i++) {
+            world.posY[i] = world.prevY[i] = 100.0f + (float)(i / 1000);
+            world.velY[i] = 0.0f;
+        }
+        start = std::chrono::steady_clock::now();
+        for (unsigned int step = 0; step < steps; step++) {
+            x.clear(); y.clear(); z.clear();
+            vx.clear(); vy.clear(); vz.clear();
+            for (CubeHandle h : moving) {
+                uint32_t i = world.indexOf(h);
+                x.push_back(world.posX[i]);
+                y.push_back(world.posY[i]);
+                z.push_back(world.posZ[i]);
+                vx.push_back(world.velX[i]);
+                vy.push_back(world.velY[i]);
+                vz.push_back(world.velZ[i]);
+            }
+            accelerateCubes(vy.data(), (int)n, dt * CUBE_GRAVITY);
+            moveCubes(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), (int)n, dt);
+            for (uint32_t k = 0; k < n; k++) {
+                uint32_t i = world.indexOf(moving[k]);
+                world.prevX[i] = world.posX[i];
+                world.prevY[i] = world.posY[i];
+                world.prevZ[i] = world.posZ[i];
+                world.posX[i] = x[k];
+                world.posY[i] = y[k];
+                world.posZ[i] = z[k];
+                world.velX[i] = vx[k];
+                world.velY[i] = vy[k];
+                world.velZ[i] = vz[k];
+            }
+        }
+        report("CubeActiveList, packed and copied back", benchSeconds(start));
+        bool same = world.posY[n - 1] == perCubeY;
+
+        start = std::chrono::steady_clock::now();
+        for (unsigned int step = 0; step < steps; step++) {
+            accelerateCubes(vy.data(), (int)n, dt * CUBE_GRAVITY);
+            moveCubes(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), (int)n, dt);
+        }
+        report("kernels only", benchSeconds(start));
+        if (!same) {
+            std::cout << "Bench integrate: the packed path ended up somewhere else than the per cube one" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* --bench sweep: the falling pile of --bench settle (cubes cubes, 10000 when 0), stepped with none, 10, 100 and 1000 of its cubes
+*  thrown upwards fast enough that CubeSolver sweeps them. The throw is repeated before every step, so each step sweeps the same
+*  number of cubes. Prints the time per step and how many cubes were swept, the time on top of the pile without throws should
+*  grow with the number of thrown cubes, not with the size of the pile.
+*/
+inline int benchSweep(unsigned int cubes) {
+    if (cubes == 0)
+        cubes = 10000;
+    const unsigned int WARMUP_STEPS = 5, STEPS = 40;
+    // A cube this fast moves 0.67 per step, more than CubeSolver::SWEEP_DISTANCE.
+    const glm::vec3 THROW(0.0f, 80.0f, 0.0f);
+    JobSystem jobs;
+    double baseline = 0.0;
+    for (unsigned int fast : { 0u, 10u, 100u, 1000u }) {
+        fast = std::min(fast, cubes);
+        Simulation simulation(&jobs);
+        simulation.spawnScene(cubes);
+        SimulationInput input;
+        // The extra cubes were spawned after the scene's 10.
+        std::vector<CubeHandle> thrown;
+        for (unsigned int k = 0; k < fast; k++)
+            thrown.push_back(simulation.world.handleOf(10 + (uint32_t)((unsigned long long)k * cubes / fast)));
+
+        double seconds = 0.0;
+        unsigned long long swept = 0;
+        for (unsigned int step = 0; step < WARMUP_STEPS + STEPS; step++) {
+            for (CubeHandle h : thrown)
+                simulation.world.setVelocity(h, THROW);
+            input.time = step * Simulation::PHYSICS_STEP;
+            auto start = std::chrono::steady_clock::now();
+            simulation.frame(Simulation::PHYSICS_STEP, input);
+            if (step >= WARMUP_STEPS) {
+                seconds += benchSeconds(start);
+                swept += simulation.solver.sweptCount;
+            }
+        }
+        double ms = seconds * 1000.0 / STEPS;
+        if (fast == 0)
+            baseline = ms;
+        std::cout << "Bench sweep: " << cubes << " cubes, " << fast << " thrown, " << swept / STEPS << " swept per step, " << ms << " ms per step";
+        if (fast > 0)
+            std::cout << ", " << (ms - baseline) * 1000.0 / fast << " us more per thrown cube";
+        std::cout << std::endl;
+    }
+    return 0;
+}
+
+/* --sweep <n>: how physics scales with threads. A flat layer of cubes cubes (1000000 when 0) a bit apart, falling, stepped with a
+*  JobSystem of 1, 2, ... up to maxThreads threads. Every thread count gets a freshly spawned layer, runs WARMUP_STEPS untimed and
+*  then times STEPS steps. The layer starts high enough that it's still in the air when the timing ends, so every timed step does the
+*  same work.
+*  Prints the time per step and the speedup over one thread, which only shows on a machine with that many cores.
+*/
+inline int benchThreads(unsigned int cubes, unsigned int maxThreads) {
+    if (cubes == 0)
+        cubes = 1000000;
+    const unsigned int WARMUP_STEPS = 5, STEPS = 30;
+    double oneThread = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int threads = 1; threads <= maxThreads; threads++) {
+        JobSystem jobs(threads);
+        Simulation simulation(&jobs);
+        // A flat layer instead of spawnScene's pile, so no two cubes touch until they land.
+        CubeWorld& world = simulation.world;
+        world.reserve(cubes);
+        unsigned int side = (unsigned int)std::ceil(std::sqrt((float)cubes));
+        for (unsigned int i = 0; i < cubes; i++) {
+            glm::vec3 position(((float)(i % side) - side * 0.5f) * 1.05f, 3.0f, ((float)(i / side) - side * 0.5f) * 1.05f);
+            CubeHandle cube = world.spawn(position, "cube", true);
+            world.setFlag(cube, CUBE_MOVING, true);
+            simulation.movingCubes.insert(cube);
+        }
+        simulation.bvh.build(world);
+        simulation.grid.build(world);
+
+        SimulationInput input;
+        for (unsigned int step = 0; step < WARMUP_STEPS + STEPS; step++) {
+            if (step == WARMUP_STEPS)
+                start = std::chrono::steady_clock::now();
+            input.time = step * Simulation::PHYSICS_STEP;
+            simulation.frame(Simulation::PHYSICS_STEP, input);
+        }
+        double ms = benchSeconds(start) * 1000.0 / STEPS;
+        if (threads == 1)
+            oneThread = ms;
+        std::cout << "Bench threads: " << cubes << " cubes, " << threads << (threads == 1 ? " thread, " : " threads, ") << ms << " ms per step, "
+            << oneThread / ms << "x one thread, " << simulation.movingCubes.size() << " cubes awake at the end" << std::endl;
+    }
+    return 0;
+}
+
+/* --bench occlusion: checks CubeOcclusion, then times it. Two checks:
+*  - rasterizeSpan (whichever of AVX2, SSE2 or scalar this build uses) against rasterizeSpanScalar on random spans whose edges cross
+*    somewhere in or near the span. They have to write the same depths, except for pixels where an edge function is within 1e-3 of 0,
+*    where a compiler fusing the scalar version's multiply and add may round the other way. Those are counted but don't fail.
+*  - that the cull never removes a cube that can be seen. cubes cubes (20000 when 0) are scattered in front of a camera looking
+*    from VIEWS places, and for every cube cull() removes, a ray is cast through CubeBVH from the camera at a point just inside each
+*    of its corners that is on screen. If the first cube the ray hits is the removed one, part of it was in plain sight.
+*/
+inline int benchOcclusion(unsigned int cubes) {
+    if (cubes == 0)
+        cubes = 20000;
+    const unsigned int SPANS = 100000, VIEWS = 16;
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    const int ROW = 256;
+    std::vector<float> simdRow(ROW), scalarRow(ROW);
+    unsigned int spanMismatches = 0, edgeMismatches = 0;
+    for (unsigned int s = 0; s < SPANS; s++) {
+        // Spans start and end on multiples of 8 like rasterizeBand makes them.
+        int x = 8 * (int)(random() % 16), end = x + 8 * (1 + (int)(random() % ((ROW - x) / 8)));
+        float e[3], step[3];
+        for (int edge = 0; edge < 3; edge++) {
+            step[edge] = (int)(s % 7) == edge ? 0.0f : unit(random) * 4.0f - 2.0f;
+            // Zero somewhere from a bit before the span to a bit after it.
+            e[edge] = -step[edge] * (unit(random) * (end - x + 16) - 8.0f) + (step[edge] == 0.0f ? unit(random) - 0.25f : 0.0f);
+        }
+        float z = unit(random), dz = (unit(random) - 0.5f) * 0.02f;
+        for (int k = 0; k < ROW; k++)
+            simdRow[k] = scalarRow[k] = unit(random);
+        rasterizeSpan(simdRow.data(), x, end, e, step, z, dz);
+        rasterizeSpanScalar(scalarRow.data(), x, end, e, step, z, dz);
+        for (int k = 0; k < ROW; k++) {
+            if (simdRow[k] == scalarRow[k])
+                continue;
+            bool edge = false;
+            for (int i = 0; i < 3; i++)
+                edge = edge || std::abs(e[i] + (k - x) * step[i]) < 1e-3f;
+            if (edge)
+                edgeMismatches++;
+            else
+                spanMismatches++;
+        }
+    }
+    std::cout << "Bench occlusion: " << SPANS << " random spans, " << CUBE_SIMD_NAME << " vs scalar: " << spanMismatches << " pixels differ, "
+        << edgeMismatches << " more on an edge" << std::endl;
+
+    CubeWorld world;
+    world.reserve(cubes);
+    for (unsigned int i = 0; i < cubes; i++)
+        world.spawn(glm::vec3(unit(random) * 80.0f - 40.0f, unit(random) * 20.0f, unit(random) * 80.0f - 40.0f), "cube", false);
+    CubeBVH bvh;
+    bvh.build(world);
+    CubeOcclusion occlusion;
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 200.0f);
+
+    std::vector<uint32_t> visible;
+    std::vector<uint8_t> kept(cubes);
+    unsigned int occluded = 0, corners = 0, seen = 0;
+    double cullSeconds = 0.0;
+    for (unsigned int v = 0; v < VIEWS; v++) {
+        // Around the edge of the box, from the ground up to above it, looking at its middle.
+        float angle = v * 6.2831853f / VIEWS;
+        glm::vec3 viewPos(std::cos(angle) * 50.0f, 2.0f + v * 1.5f, std::sin(angle) * 50.0f);
+        glm::mat4 viewProj = proj * glm::lookAt(viewPos, glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        visible.resize(cubes);
+        for (uint32_t i = 0; i < cubes; i++)
+            visible[i] = i;
+        auto start = std::chrono::steady_clock::now();
+        occlusion.cull(world, 1.0f, viewProj, viewPos, visible);
+        cullSeconds += benchSeconds(start);
+        occluded += occlusion.occludedCount;
+
+        std::fill(kept.begin(), kept.end(), 0);
+        for (uint32_t i : visible)
+            kept[i] = 1;
+        for (uint32_t i = 0; i < cubes; i++) {
+            if (kept[i])
+                continue;
+            glm::vec3 center = world.position(i);
+            for (int c = 0; c < 8; c++) {
+                glm::vec3 point = center + glm::vec3((c & 1) ? 0.45f : -0.45f, (c & 2) ? 0.45f : -0.45f, (c & 4) ? 0.45f : -0.45f);
+                glm::vec4 clip = viewProj * glm::vec4(point, 1.0f);
+                if (clip.w <= 0.0f || std::abs(clip.x) > clip.w || std::abs(clip.y) > clip.w || std::abs(clip.z) > clip.w)
+                    continue;
+                corners++;
+                if (bvh.raycast(viewPos, glm::normalize(point - viewPos)).cube == world.handleOf(i))
+                    seen++;
+            }
+        }
+    }
+    std::cout << "Bench occlusion: " << cubes << " cubes from " << VIEWS << " views, " << cullSeconds * 1000.0 / VIEWS << " ms per cull, "
+        << occluded / VIEWS << " cubes culled per view, " << corners << " corners of culled cubes on screen, " << seen << " of them in sight"
+        << std::endl;
+
+    return spanMismatches == 0 && seen == 0 ? 0 : 1;
+}
+
+// True if name is one of the benchmarks in this file.
+inline bool isBenchmark(const std::string& name) {
+    return name == "textures" || name == "picking" || name == "raycast" || name == "settle" || name == "integrate" || name == "sweep" ||
+        name == "occlusion";
+}
+
+// Runs the benchmark called name, see above. Returns main's exit code.
+inline int runBenchmark(const std::string& name, unsigned int size) {
+    if (name == "textures")
+        return benchTextures(size);
+    if (name == "picking")
+        return benchPicking(size);
+    if (name == "raycast")
+        return benchRaycast(size);
+    if (name == "settle")
+        return benchSettle(size);
+    if (name == "integrate")
+        return benchIntegrate(size);
+    if (name == "sweep")
+        return benchSweep(size);
+    if (name == "occlusion")
+        return benchOcclusion(size);
+    std::cout << "Unknown benchmark " << name << std::endl;
+    return -1;
+}
+
+#endif
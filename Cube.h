@@ -1,59 +1,54 @@
 #ifndef CUBE_H
 #define CUBE_H
 
-#include "glm/glm.hpp"
-#include <glad/glad.h>
-#include "Shader.h"
-#include <iostream>
-#include <cmath>
-#include "stb_image.h"
-
-// Vertices and normal vectors for the triangles that compose the cube, each block of 6 corresponds to one face.
+// The 24 corners of the cube, 4 per face since every face has its own normal and texture coordinates: position, normal, uv.
+// cubeIndices below puts them together into the 12 triangles.
 const float cubeVertices[] = {
         // Back
         -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
          0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
          0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-         0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
         -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
         // Front
         -0.5f, -0.5f,  0.5f,  0.0f,  1.0f,  1.0f,  0.0f, 0.0f,
          0.5f, -0.5f,  0.5f,  0.0f,  1.0f,  1.0f,  1.0f, 0.0f,
          0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  1.0f,  1.0f, 1.0f,
-         0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  1.0f,  1.0f, 1.0f,
         -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  1.0f,  0.0f, 1.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f,  1.0f,  1.0f,  0.0f, 0.0f,
         // Left
         -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
         -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
         -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
         -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-        -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
         // Right
          0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
          0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
          0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
          0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
         // Bottom
         -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
          0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
          0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-         0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
         -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
         // Top
         -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
          0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
          0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f
+        -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f
 };
 
+// Two triangles per face, in the same order as the 36 vertices the cube used to be drawn from.
+const unsigned short cubeIndices[] = {
+        0, 1, 2, 2, 3, 0, // Back
+        4, 5, 6, 6, 7, 4, // Front
+        8, 9, 10, 10, 11, 8, // Left
+        12, 13, 14, 14, 15, 12, // Right
+        16, 17, 18, 18, 19, 16, // Bottom
+        20, 21, 22, 22, 23, 20 // Top
+};
+
+const int CUBE_VERTEX_COUNT = 24;
+const int CUBE_INDEX_COUNT = 36;
+
 /*
 // Vertices for the triangles that compose the cube, each block of 6 corresponds to one face.
 const float cubeVertices[] = {
@@ -101,172 +96,4 @@ const float cubeVertices[] = {
 };
 */
 
-class Cube
-{
-private:
-    // Shader that will be applied to this cube, we need to know the shader class so that we can modify its uniform variables.
-    Shader* shader;
-    unsigned int texture0, texture1, texture2;
-
-    void checkCollision() {
-
-    }
-
-public:
-    unsigned int VBO{}, VAO{}; 
-    glm::vec3 Position{};
-    // Is the player looking at this cube? true if yes (cube colored red), false if no (cube colored white).
-    bool targeted{};
-    bool isMoving{};
-    bool isHeld{};
-    bool movable{};
-    glm::vec3 Velocity{};
-    const char* Name{};
-
-    // This checks whether the line of sight (the line of the front vector) of the player intersects with any cube faces.
-    bool isCubeTargeted(glm::vec3 cameraPos, glm::vec3 cameraFront) {
-        for (int axis = 0; axis < 3; ++axis) {
-            float dir = cameraFront[axis];
-            if (dir == 0) continue;                         // Front is prallel in to this plane, skip to prevent Divide by Zero.
-
-            float faceOffset = (dir > 0.0f) ? -0.5f : 0.5f; // Check whether nearer or farther cube face is closer to camera so we only check one plane.
-            float planePos = Position[axis] + faceOffset;
-            float t = (planePos - cameraPos[axis]) / dir;   // Determine scalar at which the front vector intersects the cube plane.
-
-            if (t < 0.0f) continue;                         // Scalar is negative, so cube is behind camera.
-
-            // Compute intersection point coordinates on the other two axes.
-            int a1 = (axis + 1) % 3;
-            int a2 = (axis + 2) % 3;
-            float interA1 = cameraPos[a1] + t * cameraFront[a1];
-            float interA2 = cameraPos[a2] + t * cameraFront[a2];
-
-            // Check whether the intersections are within the cube face.
-            if (interA1 > (Position[a1] - 0.5f) && interA1 < (Position[a1] + 0.5) &&
-                interA2 >(Position[a2] - 0.5f) && interA2 < (Position[a2] + 0.5)) {
-                targeted = true;
-                return true;
-            }
-        }
-        targeted = false;
-        return false;
-    }
-
-    // Upon construction load all the vertex data into a buffer for quick retrival later on.
-    /* Actually, so long as the cubes all have identical dimensions and textures creating a new personal buffer and texture for every cube is useless, since
-    *  they're all rendered the exact same way and the only distinguishing feature between them, the position vector, is already handled via the model matrix.
-    *  Realoading the texture file everytime is also realy silly. I should refactor this so that the buffers and textures are created once and then reused be every cube.
-    */
-    Cube(float x, float y, float z, Shader& sha, const char* name, bool mov) : shader(&sha) {
-        Position = glm::vec3(x, y, z);
-        targeted = false;
-        isMoving = false;
-        isHeld = false;
-        movable = mov;
-        Name = name;
-        Velocity = glm::vec3(0.0f, 0.0f, 0.0f);
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*) 0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*) (3* sizeof(float)));
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*) (6 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-
-        int width, height, nrChannels;
-        stbi_set_flip_vertically_on_load(true);
-
-        glGenTextures(1, &texture0);
-        glBindTexture(GL_TEXTURE_2D, texture0);
-
-        unsigned char* data = stbi_load("diamond.jpg", &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-        }
-        else
-        {
-            std::cout << "Failed to load texture" << std::endl;
-        }
-        stbi_image_free(data);
-
-        glGenTextures(1, &texture1);
-        glBindTexture(GL_TEXTURE_2D, texture1);
-
-        data = stbi_load("diamondSpec.jpg", &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-        }
-        else
-        {
-            std::cout << "Failed to load texture" << std::endl;
-        }
-        stbi_image_free(data);
-
-        glGenTextures(1, &texture2);
-        glBindTexture(GL_TEXTURE_2D, texture2);
-
-        data = stbi_load("diamondEmit.jpg", &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-        }
-        else
-        {
-            std::cout << "Failed to load texture" << std::endl;
-        }
-        stbi_image_free(data);
-    }
-
-    void drawCube() {
-        // This matrix translates the cubes vertex coordinates to its actual position.
-        glm::mat4 model = glm::translate(glm::mat4(1.0f), Position);
-        shader->setMatrix4fv("model", model);
-
-        // Sets the "color" uniform bool variable in the shader program, which changes to color to red.
-        if (targeted) {
-            shader->setInt("color", 1);
-        }
-        else {
-            shader->setInt("color", 0);
-        }
-        if (isMoving) {
-            shader->setInt("color", 2);
-            // std::cout << this << " is moving" << std::endl;
-        }
-
-        // Load the buffer containing the cube vertex and texture data. (Actually not necessary at the moment, since all objects use identical data.
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture0);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, texture2);
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-    }
-
-    bool processMovement(float dTime) {
-        Velocity += glm::vec3(0.0, -dTime * 0.5, 0.0);
-        Position += Velocity;
-        if (Position.y < 0.5) {
-            Position.y = 0.5;
-            Velocity = glm::vec3(0.0f, 0.0f, 0.0f);
-            isMoving = false;
-            return false;
-        }
-        return true;
-    }
-};
-
 #endif
\ No newline at end of file
@@ -0,0 +1,225 @@
+#ifndef CUBE_BVH_H
+#define CUBE_BVH_H
+
+#include "glm/glm.hpp"
+#include "CubeWorld.h"
+#include "CubeRaycast.h"
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+/* Bounding volume hierarchy over the cubes' bounding boxes, used to find the cube the crosshair points at without testing every cube.
+*  Built once with build(), afterwards moving cubes only refit the bounds along the path from their leaf to the root (update()).
+*  Refitting never changes which cubes share a node, so if cubes end up far away from where they were at build time the tree gets
+*  loose and build() should be called again.
+*/
+class CubeBVH
+{
+private:
+    // Leaves have count > 0 and reference the cubes [first, first + count) in prims, interior nodes have count == 0
+    // and their children are stored next to each other at first and first + 1.
+    struct Node {
+        glm::vec3 boundsMin;
+        int first;
+        glm::vec3 boundsMax;
+        int count;
+    };
+
+    // One SIMD batch per leaf, see CubeRaycast.h.
+    static const int MAX_LEAF_SIZE = RAYCAST_BATCH;
+    // All cubes are unit cubes, so their bounding box is just the center +- this.
+    static constexpr float HALF_EXTENT = 0.5f;
+
+    std::vector<Node> nodes;
+    std::vector<int> parents;
+    // Cubes in leaf order, with the centers copied next to them as separate x/y/z arrays so leaves can be tested with raycastCubes
+    // without going back to the world. The arrays are padded by RAYCAST_BATCH since the last leaf's batch reads past the end.
+    std::vector<CubeHandle> prims;
+    std::vector<float> centerX, centerY, centerZ;
+
+    glm::vec3 center(int i) const {
+        return glm::vec3(centerX[i], centerY[i], centerZ[i]);
+    }
+
+    void setCenter(int i, const glm::vec3& c) {
+        centerX[i] = c.x;
+        centerY[i] = c.y;
+        centerZ[i] = c.z;
+    }
+    // Leaf node that holds each entry of prims.
+    std::vector<int> primLeaf;
+    // Entry of prims for every handle slot of the world, so a moved cube finds its leaf directly. -1 for cubes spawned after build().
+    std::vector<int> slotToPrim;
+
+    void computeBounds(int first, int count, glm::vec3& bmin, glm::vec3& bmax) const {
+        bmin = glm::vec3(std::numeric_limits<float>::max());
+        bmax = glm::vec3(-std::numeric_limits<float>::max());
+        for (int i = first; i < first + count; i++) {
+            bmin = glm::min(bmin, center(i));
+            bmax = glm::max(bmax, center(i));
+        }
+        bmin -= glm::vec3(HALF_EXTENT);
+        bmax += glm::vec3(HALF_EXTENT);
+    }
+
+    // Slab test, returns the distance along the ray at which it enters the box or a negative value if it misses it.
+    // A node containing the origin counts as hit at 0, since cubes inside of it might still be in front of the camera.
+    static float intersect(const glm::vec3& bmin, const glm::vec3& bmax, const glm::vec3& origin, const glm::vec3& invDir, float maxT) {
+        float tmin = 0.0f, tmax = maxT;
+        for (int axis = 0; axis < 3; axis++) {
+            float t1 = (bmin[axis] - origin[axis]) * invDir[axis];
+            float t2 = (bmax[axis] - origin[axis]) * invDir[axis];
+            tmin = std::max(tmin, std::min(t1, t2));
+            tmax = std::min(tmax, std::max(t1, t2));
+        }
+        return tmin <= tmax ? tmin : -1.0f;
+    }
+
+public:
+    struct Hit {
+        CubeHandle cube;
+        float t = std::numeric_limits<float>::max();
+    };
+
+    // Has to be called again after cubes were spawned or despawned.
+    void build(const CubeWorld& world) {
+        int n = (int)world.size();
+        prims.resize(n);
+        centerX.assign(n + RAYCAST_BATCH, 0.0f);
+        centerY.assign(n + RAYCAST_BATCH, 0.0f);
+        centerZ.assign(n + RAYCAST_BATCH, 0.0f);
+        primLeaf.resize(n);
+        // Cubes and centers are partitioned together, the separate arrays are only refreshed from this afterwards.
+        struct Item {
+            glm::vec3 center;
+            CubeHandle cube;
+        };
+        std::vector<Item> items(n);
+        for (int i = 0; i < n; i++) {
+            items[i] = Item{ world.position((uint32_t)i), world.handleOf((uint32_t)i) };
+            prims[i] = items[i].cube;
+            setCenter(i, items[i].center);
+        }
+        slotToPrim.assign(world.slotCount(), -1);
+
+        nodes.clear();
+        parents.clear();
+        if (n == 0)
+            return;
+        nodes.reserve(2 * (n / MAX_LEAF_SIZE + 1));
+        parents.reserve(nodes.capacity());
+        nodes.push_back(Node{ glm::vec3(0.0f), 0, glm::vec3(0.0f), n });
+        parents.push_back(-1);
+
+        // Top down, splitting every node at the median of its longest axis. A stack instead of recursion since a million cubes is not unusual.
+        std::vector<int> stack = { 0 };
+        while (!stack.empty()) {
+            int index = stack.back();
+            stack.pop_back();
+            int first = nodes[index].first, count = nodes[index].count;
+            computeBounds(first, count, nodes[index].boundsMin, nodes[index].boundsMax);
+
+            if (count <= MAX_LEAF_SIZE) {
+                for (int i = first; i < first + count; i++)
+                    primLeaf[i] = index;
+                continue;
+            }
+
+            glm::vec3 extent = nodes[index].boundsMax - nodes[index].boundsMin;
+            int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+            int half = count / 2;
+
+            std::nth_element(items.begin() + first, items.begin() + first + half, items.begin() + first + count,
+                [axis](const Item& a, const Item& b) { return a.center[axis] < b.center[axis]; });
+            for (int i = first; i < first + count; i++) {
+                setCenter(i, items[i].center);
+                prims[i] = items[i].cube;
+            }
+
+            int left = (int)nodes.size();
+            nodes.push_back(Node{ glm::vec3(0.0f), first, glm::vec3(0.0f), half });
+            nodes.push_back(Node{ glm::vec3(0.0f), first + half, glm::vec3(0.0f), count - half });
+            parents.push_back(index);
+            parents.push_back(index);
+            nodes[index].first = left;
+            nodes[index].count = 0;
+            stack.push_back(left);
+            stack.push_back(left + 1);
+        }
+
+        for (int i = 0; i < n; i++)
+            slotToPrim[prims[i].slot] = i;
+    }
+
+    // Refits the tree after the cube moved. Only the cube's leaf and its ancestors are touched, and only as far up as bounds actually change.
+    void update(const CubeWorld& world, CubeHandle cube) {
+        if (cube.slot >= slotToPrim.size() || slotToPrim[cube.slot] < 0 || prims[slotToPrim[cube.slot]] != cube)
+            return;
+        int slot = slotToPrim[cube.slot];
+        setCenter(slot, world.position(cube));
+
+        int index = primLeaf[slot];
+        computeBounds(nodes[index].first, nodes[index].count, nodes[index].boundsMin, nodes[index].boundsMax);
+        for (index = parents[index]; index >= 0; index = parents[index]) {
+            Node& node = nodes[index];
+            const Node& left = nodes[node.first];
+            const Node& right = nodes[node.first + 1];
+            glm::vec3 bmin = glm::min(left.boundsMin, right.boundsMin);
+            glm::vec3 bmax = glm::max(left.boundsMax, right.boundsMax);
+            if (bmin == node.boundsMin && bmax == node.boundsMax)
+                break;
+            node.boundsMin = bmin;
+            node.boundsMax = bmax;
+        }
+    }
+
+    // Closest cube hit by the ray, cubes the origin is inside of don't count.
+    Hit raycast(const glm::vec3& origin, const glm::vec3& dir) const {
+        Hit hit;
+        if (nodes.empty())
+            return hit;
+
+        glm::vec3 invDir = rayInverseDirection(dir);
+
+        int stack[64];
+        int stackSize = 0;
+        if (intersect(nodes[0].boundsMin, nodes[0].boundsMax, origin, invDir, hit.t) >= 0.0f)
+            stack[stackSize++] = 0;
+
+        while (stackSize > 0) {
+            const Node& node = nodes[stack[--stackSize]];
+            if (node.count > 0) {
+                CubeRayHit leafHit = raycastCubes(&centerX[node.first], &centerY[node.first], &centerZ[node.first], node.count, origin, invDir, hit.t);
+                if (leafHit.index >= 0) {
+                    hit.t = leafHit.t;
+                    hit.cube = prims[node.first + leafHit.index];
+                }
+                continue;
+            }
+
+            // Visit the nearer child first, so the farther one can often be skipped because it starts behind the closest hit so far.
+            // When the origin is inside both they tie at 0, then the one further along the ray's direction goes second.
+            const Node& left = nodes[node.first];
+            const Node& right = nodes[node.first + 1];
+            float tLeft = intersect(left.boundsMin, left.boundsMax, origin, invDir, hit.t);
+            float tRight = intersect(right.boundsMin, right.boundsMax, origin, invDir, hit.t);
+            bool rightFirst = tLeft == tRight && glm::dot(right.boundsMin + right.boundsMax - left.boundsMin - left.boundsMax, dir) < 0.0f;
+            int nearChild = node.first, farChild = node.first + 1;
+            if (tRight >= 0.0f && (tLeft < 0.0f || tRight < tLeft || rightFirst)) {
+                std::swap(nearChild, farChild);
+                std::swap(tLeft, tRight);
+            }
+            if (tRight >= 0.0f)
+                stack[stackSize++] = farChild;
+            if (tLeft >= 0.0f)
+                stack[stackSize++] = nearChild;
+        }
+        return hit;
+    }
+
+    size_t size() const {
+        return prims.size();
+    }
+};
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef CUBE_CULLING_H
+#define CUBE_CULLING_H
+
+#include "glm/glm.hpp"
+#include "CubeWorld.h"
+#include "JobSystem.h"
+#include "CubeSimd.h"
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+/* The six planes of a view frustum, as (normal, distance) with the normals pointing inwards, so a point p is inside when
+*  dot(normal, p) + distance >= 0 for all of them. Taken straight from the rows of proj * view (Gribb and Hartmann): a clip space
+*  point is inside when -w <= x, y, z <= w, and each of those six inequalities is a plane in world space.
+*/
+struct CubeFrustum {
+    glm::vec4 planes[6];
+
+    CubeFrustum() = default;
+
+    explicit CubeFrustum(const glm::mat4& viewProj) {
+        // glm is column major, viewProj[c][r] is row r of column c.
+        glm::vec4 rows[4];
+        for (int r = 0; r < 4; r++)
+            rows[r] = glm::vec4(viewProj[0][r], viewProj[1][r], viewProj[2][r], viewProj[3][r]);
+        for (int axis = 0; axis < 3; axis++) {
+            planes[axis * 2] = rows[3] + rows[axis];
+            planes[axis * 2 + 1] = rows[3] - rows[axis];
+        }
+        // Normalized so the distance to a plane is in world units and a box's reach can be compared to it.
+        for (int p = 0; p < 6; p++)
+            planes[p] /= glm::length(glm::vec3(planes[p]));
+    }
+};
+
+/* Visibility of count unit cubes that are drawn somewhere between their previous position (px, py, pz) and their current one (x, y, z),
+*  see CubeWorld::interpolatedPosition. The box tested is the one around both, so a cube is never culled for the wrong alpha. A cube is
+*  culled only when its box is completely behind one of the planes, boxes near a corner of the frustum can be kept even though they're
+*  outside, which is fine, the GPU clips them. visible[i] is set to 1 or 0. The scalar version is the reference and handles the tail.
+*/
+inline void cullCubesScalar(const float* x, const float* y, const float* z, const float* px, const float* py, const float* pz, int count,
+    const CubeFrustum& frustum, uint8_t* visible) {
+    for (int i = 0; i < count; i++) {
+        glm::vec3 d(x[i] - px[i], y[i] - py[i], z[i] - pz[i]);
+        glm::vec3 center = glm::vec3(x[i], y[i], z[i]) - d * 0.5f;
+        glm::vec3 extent = glm::vec3(0.5f) + glm::abs(d) * 0.5f;
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++) {
+            const glm::vec4& plane = frustum.planes[p];
+            // How far the box reaches towards the plane's normal.
+            float reach = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+            inside = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w + reach >= 0.0f;
+        }
+        visible[i] = inside ? 1 : 0;
+    }
+}
+
+#if defined(CUBE_SIMD_AVX2)
+
+inline void cullCubes(const float* x, const float* y, const float* z, const float* px, const float* py, const float* pz, int count,
+    const CubeFrustum& frustum, uint8_t* visible) {
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 cx = _mm256_loadu_ps(x + i), cy = _mm256_loadu_ps(y + i), cz = _mm256_loadu_ps(z + i);
+        __m256 dx = _mm256_sub_ps(cx, _mm256_loadu_ps(px + i));
+        __m256 dy = _mm256_sub_ps(cy, _mm256_loadu_ps(py + i));
+        __m256 dz = _mm256_sub_ps(cz, _mm256_loadu_ps(pz + i));
+        // Center and extent of the box around both positions.
+        cx = _mm256_sub_ps(cx, _mm256_mul_ps(dx, half));
+        cy = _mm256_sub_ps(cy, _mm256_mul_ps(dy, half));
+        cz = _mm256_sub_ps(cz, _mm256_mul_ps(dz, half));
+        __m256 ex = _mm256_add_ps(half, _mm256_mul_ps(_mm256_and_ps(dx, absMask), half));
+        __m256 ey = _mm256_add_ps(half, _mm256_mul_ps(_mm256_and_ps(dy, absMask), half));
+        __m256 ez = _mm256_add_ps(half, _mm256_mul_ps(_mm256_and_ps(dz, absMask), half));
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            const glm::vec4& plane = frustum.planes[p];
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), cx), _mm256_mul_ps(_mm256_set1_ps(plane.y), cy)),
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), cz), _mm256_set1_ps(plane.w)));
+            __m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::abs(plane.x)), ex), _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.y)), ey)),
+                _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.z)), ez));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, reach), zero, _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        for (int lane = 0; lane < 8; lane++)
+            visible[i + lane] = (uint8_t)((mask >> lane) & 1);
+    }
+    cullCubesScalar(x + i, y + i, z + i, px + i, py + i, pz + i, count - i, frustum, visible + i);
+}
+
+#elif defined(CUBE_SIMD_SSE2)
+
+inline void cullCubes(const float* x, const float* y, const float* z, const float* px, const float* py, const float* pz, int count,
+    const CubeFrustum& frustum, uint8_t* visible) {
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 cx = _mm_loadu_ps(x + i), cy = _mm_loadu_ps(y + i), cz = _mm_loadu_ps(z + i);
+        __m128 dx = _mm_sub_ps(cx, _mm_loadu_ps(px + i));
+        __m128 dy = _mm_sub_ps(cy, _mm_loadu_ps(py + i));
+        __m128 dz = _mm_sub_ps(cz, _mm_loadu_ps(pz + i));
+        cx = _mm_sub_ps(cx, _mm_mul_ps(dx, half));
+        cy = _mm_sub_ps(cy, _mm_mul_ps(dy, half));
+        cz = _mm_sub_ps(cz, _mm_mul_ps(dz, half));
+        __m128 ex = _mm_add_ps(half, _mm_mul_ps(_mm_and_ps(dx, absMask), half));
+        __m128 ey = _mm_add_ps(half, _mm_mul_ps(_mm_and_ps(dy, absMask), half));
+        __m128 ez = _mm_add_ps(half, _mm_mul_ps(_mm_and_ps(dz, absMask), half));
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            const glm::vec4& plane = frustum.planes[p];
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx), _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), cz), _mm_set1_ps(plane.w)));
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), ex), _mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), ey)),
+                _mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, reach), zero));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4; lane++)
+            visible[i + lane] = (uint8_t)((mask >> lane) & 1);
+    }
+    cullCubesScalar(x + i, y + i, z + i, px + i, py + i, pz + i, count - i, frustum, visible + i);
+}
+
+#else
+
+inline void cullCubes(const float* x, const float* y, const float* z, const float* px, const float* py, const float* pz, int count,
+    const CubeFrustum& frustum, uint8_t* visible) {
+    cullCubesScalar(x, y, z, px, py, pz, count, frustum, visible);
+}
+
+#endif
+
+// Frustum culls every cube of the world for any alpha (see cullCubes), grain cubes per job. The indices of the cubes that are
+// left go into visible in increasing order, flags is scratch space with one byte per cube.
+inline void frustumCullWorld(const CubeWorld& world, const CubeFrustum& frustum, JobSystem* jobs, uint32_t grain, std::vector<uint8_t>& flags,
+    std::vector<uint32_t>& visible) {
+    uint32_t count = (uint32_t)world.size();
+    flags.resize(count);
+    parallelFor(jobs, count, grain, [&](uint32_t begin, uint32_t end) {
+        cullCubes(world.posX.data() + begin, world.posY.data() + begin, world.posZ.data() + begin, world.prevX.data() + begin,
+            world.prevY.data() + begin, world.prevZ.data() + begin, (int)(end - begin), frustum, flags.data() + begin);
+    });
+    visible.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        if (flags[i])
+            visible.push_back(i);
+    }
+}
+
+#endif
@@ -0,0 +1,321 @@
+#ifndef CUBE_GRID_H
+#define CUBE_GRID_H
+
+#include "glm/glm.hpp"
+#include "CubeWorld.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+/* Uniform grid of cube sized cells, hashed on the integer cell coordinates so only cells that hold cubes take memory, however far
+*  apart the cubes are. Every cube is filed under the one cell its center is in, and the cubes of a cell are linked together, so a
+*  moving cube only has to be unlinked and linked again when it crosses into another cell.
+*
+*  Queries look at the cells around the area asked for (grown by half a cube, since a cube reaches into the cells next to its center)
+*  and only then at the cubes in them, so they cost as much as the cubes near the area, no matter how many cubes there are elsewhere.
+*/
+class CubeGrid
+{
+private:
+    // All cubes are unit cubes, see CubeBVH.
+    static constexpr float HALF_EXTENT = 0.5f;
+    static constexpr float CELL_SIZE = 1.0f;
+    static constexpr uint64_t EMPTY_KEY = ~0ull;
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
+    // Cell coordinates are stored with this offset in 21 bits each, which covers a million cells in every direction.
+    static const int COORD_BIAS = 1 << 20;
+
+    // Per handle slot of the world: the cube's center, the cell it's filed under, and its neighbors in that cell's list.
+    struct Entry {
+        glm::vec3 center;
+        uint64_t cell;
+        uint32_t prev, next;
+    };
+    std::vector<Entry> entries;
+    std::vector<CubeHandle> proxies;
+
+    // Cell key -> first cube of the cell, open addressing with linear probing. Cells are removed when their last cube leaves.
+    std::vector<uint64_t> tableKeys;
+    std::vector<uint32_t> tableHead;
+    size_t tableMask{};
+    size_t cellCount{};
+    // Box around every cell that was occupied since the grid was last empty, only ever grows in between. Rays are clipped to it, see raycast().
+    glm::ivec3 occupiedMin{}, occupiedMax{};
+
+    static int cellCoord(float v) {
+        return (int)std::floor(v / CELL_SIZE);
+    }
+
+    static uint64_t cellKey(int x, int y, int z) {
+        return (uint64_t)(x + COORD_BIAS) << 42 | (uint64_t)(y + COORD_BIAS) << 21 | (uint64_t)(z + COORD_BIAS);
+    }
+
+    static uint64_t cellKey(const glm::vec3& p) {
+        return cellKey(cellCoord(p.x), cellCoord(p.y), cellCoord(p.z));
+    }
+
+    size_t tableHome(uint64_t key) const {
+        return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & tableMask;
+    }
+
+    size_t tableFind(uint64_t key) const {
+        size_t i = tableHome(key);
+        while (tableKeys[i] != EMPTY_KEY && tableKeys[i] != key)
+            i = (i + 1) & tableMask;
+        return i;
+    }
+
+    void tableRebuild(size_t capacity) {
+        std::vector<uint64_t> oldKeys;
+        std::vector<uint32_t> oldHead;
+        oldKeys.swap(tableKeys);
+        oldHead.swap(tableHead);
+        tableKeys.assign(capacity, EMPTY_KEY);
+        tableHead.assign(capacity, NONE);
+        tableMask = capacity - 1;
+        for (size_t j = 0; j < oldKeys.size(); j++) {
+            if (oldKeys[j] == EMPTY_KEY)
+                continue;
+            size_t i = tableFind(oldKeys[j]);
+            tableKeys[i] = oldKeys[j];
+            tableHead[i] = oldHead[j];
+        }
+    }
+
+    // First cube of the cell, NONE if it's empty.
+    uint32_t cellHead(int x, int y, int z) const {
+        if (cellCount == 0)
+            return NONE;
+        size_t i = tableFind(cellKey(x, y, z));
+        return tableKeys[i] == EMPTY_KEY ? NONE : tableHead[i];
+    }
+
+    void link(uint32_t slot) {
+        // Kept at most half full so probe sequences stay short.
+        if ((cellCount + 1) * 2 > tableKeys.size())
+            tableRebuild(std::max<size_t>(64, tableKeys.size() * 2));
+        Entry& e = entries[slot];
+        size_t i = tableFind(e.cell);
+        if (tableKeys[i] == EMPTY_KEY) {
+            tableKeys[i] = e.cell;
+            tableHead[i] = NONE;
+            glm::ivec3 c = cellOf(e.center);
+            occupiedMin = cellCount == 0 ? c : glm::min(occupiedMin, c);
+            occupiedMax = cellCount == 0 ? c : glm::max(occupiedMax, c);
+            cellCount++;
+        }
+        e.prev = NONE;
+        e.next = tableHead[i];
+        if (e.next != NONE)
+            entries[e.next].prev = slot;
+        tableHead[i] = slot;
+    }
+
+    void unlink(uint32_t slot) {
+        Entry& e = entries[slot];
+        if (e.next != NONE)
+            entries[e.next].prev = e.prev;
+        if (e.prev != NONE) {
+            entries[e.prev].next = e.next;
+            return;
+        }
+        size_t i = tableFind(e.cell);
+        tableHead[i] = e.next;
+        if (e.next != NONE)
+            return;
+
+        // The cell is empty now. Backward shift deletion, moves later entries of the probe sequence up so no tombstones are needed.
+        cellCount--;
+        size_t j = i;
+        for (;;) {
+            j = (j + 1) & tableMask;
+            if (tableKeys[j] == EMPTY_KEY)
+                break;
+            size_t home = tableHome(tableKeys[j]);
+            bool between = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+            if (!between) {
+                tableKeys[i] = tableKeys[j];
+                tableHead[i] = tableHead[j];
+                i = j;
+            }
+        }
+        tableKeys[i] = EMPTY_KEY;
+    }
+
+    bool known(CubeHandle cube) const {
+        return cube.slot < proxies.size() && proxies[cube.slot] == cube;
+    }
+
+    // Calls f(slot) for every cube filed in the cells [lo, hi].
+    template<typename F>
+    void forEachInCells(const glm::ivec3& lo, const glm::ivec3& hi, F f) const {
+        for (int x = lo.x; x <= hi.x; x++) {
+            for (int y = lo.y; y <= hi.y; y++) {
+                for (int z = lo.z; z <= hi.z; z++) {
+                    for (uint32_t slot = cellHead(x, y, z); slot != NONE; slot = entries[slot].next)
+                        f(slot);
+                }
+            }
+        }
+    }
+
+    static glm::ivec3 cellOf(const glm::vec3& p) {
+        return glm::ivec3(cellCoord(p.x), cellCoord(p.y), cellCoord(p.z));
+    }
+
+public:
+    struct Hit {
+        CubeHandle cube;
+        float t = std::numeric_limits<float>::max();
+    };
+
+    // Files every cube of the world from scratch.
+    void build(const CubeWorld& world) {
+        entries.assign(world.slotCount(), Entry{ glm::vec3(0.0f), EMPTY_KEY, NONE, NONE });
+        proxies.assign(world.slotCount(), CubeHandle());
+        cellCount = 0;
+        tableKeys.clear();
+        tableHead.clear();
+        tableRebuild(64);
+        for (uint32_t i = 0; i < world.size(); i++)
+            insert(world, world.handleOf(i));
+    }
+
+    // Adds a cube spawned after build().
+    void insert(const CubeWorld& world, CubeHandle cube) {
+        if (cube.slot >= proxies.size()) {
+            entries.resize(cube.slot + 1, Entry{ glm::vec3(0.0f), EMPTY_KEY, NONE, NONE });
+            proxies.resize(cube.slot + 1);
+        }
+        if (known(cube))
+            return;
+        if (proxies[cube.slot])
+            remove(proxies[cube.slot]);
+        proxies[cube.slot] = cube;
+        entries[cube.slot].center = world.position(cube);
+        entries[cube.slot].cell = cellKey(entries[cube.slot].center);
+        link(cube.slot);
+    }
+
+    // Takes a cube out of the grid, has to happen before it's despawned.
+    void remove(CubeHandle cube) {
+        if (!known(cube))
+            return;
+        unlink(cube.slot);
+        proxies[cube.slot] = CubeHandle();
+    }
+
+    // Moves the cube to where it is now, only touches the cell lists if it crossed into another cell.
+    void update(const CubeWorld& world, CubeHandle cube) {
+        if (!known(cube))
+            return;
+        Entry& e = entries[cube.slot];
+        e.center = world.position(cube);
+        uint64_t cell = cellKey(e.center);
+        if (cell == e.cell)
+            return;
+        unlink(cube.slot);
+        e.cell = cell;
+        link(cube.slot);
+    }
+
+    // Calls f(cube) with every cube whose box touches or overlaps the box [boxMin, boxMax].
+    template<typename F>
+    void forEachInBox(const glm::vec3& boxMin, const glm::vec3& boxMax, F f) const {
+        forEachInCells(cellOf(boxMin - glm::vec3(HALF_EXTENT)), cellOf(boxMax + glm::vec3(HALF_EXTENT)), [&](uint32_t slot) {
+            const glm::vec3& c = entries[slot].center;
+            if (c.x + HALF_EXTENT >= boxMin.x && c.x - HALF_EXTENT <= boxMax.x && c.y + HALF_EXTENT >= boxMin.y &&
+                c.y - HALF_EXTENT <= boxMax.y && c.z + HALF_EXTENT >= boxMin.z && c.z - HALF_EXTENT <= boxMax.z)
+                f(proxies[slot]);
+        });
+    }
+
+    // Calls f(cube) with every cube whose box is at most radius away from center.
+    template<typename F>
+    void forEachInRadius(const glm::vec3& center, float radius, F f) const {
+        glm::vec3 reach(radius + HALF_EXTENT);
+        forEachInCells(cellOf(center - reach), cellOf(center + reach), [&](uint32_t slot) {
+            const glm::vec3& c = entries[slot].center;
+            glm::vec3 closest = glm::clamp(center, c - glm::vec3(HALF_EXTENT), c + glm::vec3(HALF_EXTENT));
+            glm::vec3 d = closest - center;
+            if (glm::dot(d, d) <= radius * radius)
+                f(proxies[slot]);
+        });
+    }
+
+    /* Closest cube hit by the ray within maxT, cubes the origin is inside of don't count (same as CubeBVH::raycast). Walks the cells
+    *  along the ray in order (3D DDA). For every stretch of the ray inside one cell, the cubes near that stretch are tested, and a cube
+    *  counts only in the stretch where the ray enters it, so the walk can stop at the end of the first stretch that hit anything.
+    *  The walk only covers the part of the ray inside the occupied cells (plus the half cube the cubes reach out of them), so a miss
+    *  ends where the ray leaves them, and maxT may be as large as FLT_MAX or infinity.
+    */
+    Hit raycast(const glm::vec3& origin, const glm::vec3& dir, float maxT) const {
+        Hit hit;
+        if (cellCount == 0)
+            return hit;
+        glm::vec3 invDir;
+        for (int axis = 0; axis < 3; axis++)
+            invDir[axis] = dir[axis] != 0.0f ? 1.0f / dir[axis] : std::numeric_limits<float>::infinity();
+
+        // Clip the ray to the box every cube is in, nothing outside of it can be hit.
+        glm::vec3 boundsMin = glm::vec3(occupiedMin) * CELL_SIZE - glm::vec3(HALF_EXTENT);
+        glm::vec3 boundsMax = glm::vec3(occupiedMax + glm::ivec3(1)) * CELL_SIZE + glm::vec3(HALF_EXTENT);
+        float tEnter = 0.0f;
+        for (int axis = 0; axis < 3; axis++) {
+            if (dir[axis] == 0.0f) {
+                if (origin[axis] < boundsMin[axis] || origin[axis] > boundsMax[axis])
+                    return hit;
+                continue;
+            }
+            float n = (boundsMin[axis] - origin[axis]) * invDir[axis];
+            float f = (boundsMax[axis] - origin[axis]) * invDir[axis];
+            tEnter = std::max(tEnter, std::min(n, f));
+            maxT = std::min(maxT, std::max(n, f));
+        }
+        if (tEnter > maxT)
+            return hit;
+
+        // Distance along the ray to the next cell boundary on each axis, and between two boundaries. The walk starts where the ray enters the box.
+        glm::ivec3 cell = cellOf(origin + dir * tEnter);
+        glm::vec3 tNext, tDelta;
+        for (int axis = 0; axis < 3; axis++) {
+            tDelta[axis] = dir[axis] != 0.0f ? CELL_SIZE * std::abs(invDir[axis]) : std::numeric_limits<float>::infinity();
+            float boundary = (cell[axis] + (dir[axis] > 0.0f ? 1 : 0)) * CELL_SIZE;
+            tNext[axis] = dir[axis] != 0.0f ? (boundary - origin[axis]) * invDir[axis] : std::numeric_limits<float>::infinity();
+        }
+
+        while (tEnter <= maxT) {
+            float tExit = std::min(std::min(tNext.x, tNext.y), std::min(tNext.z, maxT));
+            glm::vec3 a = origin + dir * tEnter, b = origin + dir * tExit;
+            forEachInCells(cellOf(glm::min(a, b) - glm::vec3(HALF_EXTENT)), cellOf(glm::max(a, b) + glm::vec3(HALF_EXTENT)), [&](uint32_t slot) {
+                const glm::vec3& c = entries[slot].center;
+                float t0 = -std::numeric_limits<float>::max(), t1 = maxT;
+                for (int axis = 0; axis < 3; axis++) {
+                    float n = (c[axis] - HALF_EXTENT - origin[axis]) * invDir[axis];
+                    float f = (c[axis] + HALF_EXTENT - origin[axis]) * invDir[axis];
+                    if (dir[axis] == 0.0f) {
+                        if (std::abs(origin[axis] - c[axis]) > HALF_EXTENT)
+                            return;
+                        continue;
+                    }
+                    t0 = std::max(t0, std::min(n, f));
+                    t1 = std::min(t1, std::max(n, f));
+                }
+                if (t0 >= tEnter && t0 < tExit && t0 <= t1 && t0 < hit.t) {
+                    hit.t = t0;
+                    hit.cube = proxies[slot];
+                }
+            });
+            if (hit.cube || tExit >= maxT)
+                break;
+            int axis = tNext.x < tNext.y ? (tNext.x < tNext.z ? 0 : 2) : (tNext.y < tNext.z ? 1 : 2);
+            tEnter = tExit;
+            tNext[axis] += tDelta[axis];
+        }
+        return hit;
+    }
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef CUBE_INTEGRATE_H
+#define CUBE_INTEGRATE_H
+
+#include "CubeSimd.h"
+
+/* Integration kernels over packed structure of arrays, entry i of every array is the same cube. Used by CubeSolver on its copy of
+*  the awake cubes, where everything is contiguous so whole SIMD registers of cubes are updated at once. The scalar versions are the
+*  reference and handle the tail that doesn't fill a register.
+*/
+
+// vy[i] -= dv, gravity for one step.
+inline void accelerateCubesScalar(float* vy, int count, float dv) {
+    for (int i = 0; i < count; i++)
+        vy[i] -= dv;
+}
+
+// p[i] += v[i] * dt on every axis.
+inline void moveCubesScalar(float* px, float* py, float* pz, const float* vx, const float* vy, const float* vz, int count, float dt) {
+    for (int i = 0; i < count; i++) {
+        px[i] += vx[i] * dt;
+        py[i] += vy[i] * dt;
+        pz[i] += vz[i] * dt;
+    }
+}
+
+#if defined(CUBE_SIMD_AVX2)
+
+inline void accelerateCubes(float* vy, int count, float dv) {
+    const __m256 d = _mm256_set1_ps(dv);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(vy + i, _mm256_sub_ps(_mm256_loadu_ps(vy + i), d));
+    accelerateCubesScalar(vy + i, count - i, dv);
+}
+
+inline void moveCubes(float* px, float* py, float* pz, const float* vx, const float* vy, const float* vz, int count, float dt) {
+    const __m256 t = _mm256_set1_ps(dt);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(px + i, _mm256_add_ps(_mm256_loadu_ps(px + i), _mm256_mul_ps(_mm256_loadu_ps(vx + i), t)));
+        _mm256_storeu_ps(py + i, _mm256_add_ps(_mm256_loadu_ps(py + i), _mm256_mul_ps(_mm256_loadu_ps(vy + i), t)));
+        _mm256_storeu_ps(pz + i, _mm256_add_ps(_mm256_loadu_ps(pz + i), _mm256_mul_ps(_mm256_loadu_ps(vz + i), t)));
+    }
+    moveCubesScalar(px + i, py + i, pz + i, vx + i, vy + i, vz + i, count - i, dt);
+}
+
+#elif defined(CUBE_SIMD_SSE2)
+
+inline void accelerateCubes(float* vy, int count, float dv) {
+    const __m128 d = _mm_set1_ps(dv);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(vy + i, _mm_sub_ps(_mm_loadu_ps(vy + i), d));
+    accelerateCubesScalar(vy + i, count - i, dv);
+}
+
+inline void moveCubes(float* px, float* py, float* pz, const float* vx, const float* vy, const float* vz, int count, float dt) {
+    const __m128 t = _mm_set1_ps(dt);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(px + i, _mm_add_ps(_mm_loadu_ps(px + i), _mm_mul_ps(_mm_loadu_ps(vx + i), t)));
+        _mm_storeu_ps(py + i, _mm_add_ps(_mm_loadu_ps(py + i), _mm_mul_ps(_mm_loadu_ps(vy + i), t)));
+        _mm_storeu_ps(pz + i, _mm_add_ps(_mm_loadu_ps(pz + i), _mm_mul_ps(_mm_loadu_ps(vz + i), t)));
+    }
+    moveCubesScalar(px + i, py + i, pz + i, vx + i, vy + i, vz + i, count - i, dt);
+}
+
+#else
+
+inline void accelerateCubes(float* vy, int count, float dv) {
+    accelerateCubesScalar(vy, count, dv);
+}
+
+inline void moveCubes(float* px, float* py, float* pz, const float* vx, const float* vy, const float* vz, int count, float dt) {
+    moveCubesScalar(px, py, pz, vx, vy, vz, count, dt);
+}
+
+#endif
+
+#endif
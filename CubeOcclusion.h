@@ -0,0 +1,316 @@
+#ifndef CUBE_OCCLUSION_H
+#define CUBE_OCCLUSION_H
+
+#include "glm/glm.hpp"
+#include "CubeWorld.h"
+#include "JobSystem.h"
+#include "CubeSimd.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/* One span of a triangle on a row of the depth buffer: pixels [x, end) of row, where the three edge functions at pixel x are e and
+*  change by step per pixel, and the depth is z changing by dz. A pixel is covered when all three edge functions are positive, it then
+*  keeps the nearer of its depth and the triangle's. The scalar version is the reference and works for any span, the SIMD versions
+*  expect end - x to be a multiple of 8.
+*/
+inline void rasterizeSpanScalar(float* row, int x, int end, const float e[3], const float step[3], float z, float dz) {
+    for (int k = 0; x + k < end; k++) {
+        if (e[0] + k * step[0] > 0.0f && e[1] + k * step[1] > 0.0f && e[2] + k * step[2] > 0.0f)
+            row[x + k] = std::min(row[x + k], z + k * dz);
+    }
+}
+
+#if defined(CUBE_SIMD_AVX2)
+
+inline void rasterizeSpan(float* row, int x, int end, const float e[3], const float step[3], float z, float dz) {
+    const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    for (int k = 0; x + k < end; k += 8) {
+        // Evaluated from the span's start every time instead of adding up steps, so rounding doesn't drift along long spans.
+        __m256 offset = _mm256_add_ps(_mm256_set1_ps((float)k), lanes);
+        __m256 inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_set1_ps(e[0]), _mm256_mul_ps(offset, _mm256_set1_ps(step[0]))), zero, _CMP_GT_OQ);
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_set1_ps(e[1]), _mm256_mul_ps(offset, _mm256_set1_ps(step[1]))), zero, _CMP_GT_OQ));
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_set1_ps(e[2]), _mm256_mul_ps(offset, _mm256_set1_ps(step[2]))), zero, _CMP_GT_OQ));
+        __m256 depth = _mm256_add_ps(_mm256_set1_ps(z), _mm256_mul_ps(offset, _mm256_set1_ps(dz)));
+        __m256 old = _mm256_loadu_ps(row + x + k);
+        _mm256_storeu_ps(row + x + k, _mm256_blendv_ps(old, _mm256_min_ps(old, depth), inside));
+    }
+}
+
+#elif defined(CUBE_SIMD_SSE2)
+
+inline void rasterizeSpan(float* row, int x, int end, const float e[3], const float step[3], float z, float dz) {
+    const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const __m128 zero = _mm_setzero_ps();
+    for (int k = 0; x + k < end; k += 4) {
+        __m128 offset = _mm_add_ps(_mm_set1_ps((float)k), lanes);
+        __m128 inside = _mm_cmpgt_ps(_mm_add_ps(_mm_set1_ps(e[0]), _mm_mul_ps(offset, _mm_set1_ps(step[0]))), zero);
+        inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(_mm_set1_ps(e[1]), _mm_mul_ps(offset, _mm_set1_ps(step[1]))), zero));
+        inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(_mm_set1_ps(e[2]), _mm_mul_ps(offset, _mm_set1_ps(step[2]))), zero));
+        __m128 depth = _mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(offset, _mm_set1_ps(dz)));
+        __m128 old = _mm_loadu_ps(row + x + k);
+        // SSE2 has no blend, select with and/andnot/or.
+        __m128 nearer = _mm_min_ps(old, depth);
+        _mm_storeu_ps(row + x + k, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+    }
+}
+
+#else
+
+inline void rasterizeSpan(float* row, int x, int end, const float e[3], const float step[3], float z, float dz) {
+    rasterizeSpanScalar(row, x, end, e, step, z, dz);
+}
+
+#endif
+
+/* Occlusion culling on the CPU. The cubes nearest to the camera are drawn as occluders into a small depth buffer by a software
+*  rasterizer, a pyramid of ever coarser versions of it is built where every texel holds the farthest depth of the four below it
+*  (hi-Z), and every cube is then tested against the pyramid: if even the nearest point of its box is behind everything in the
+*  texels its screen rectangle covers, it can't be seen and isn't drawn.
+*
+*  Everything errs on the side of drawing. Occluders only cover the pixels they cover completely and write the farthest depth they
+*  have in them, so a pixel never claims to hide more than the full resolution image would, and cubes that reach behind the near
+*  plane are never occluders and always drawn. The rasterizer works on bands of rows, one job each, so no two threads write the
+*  same pixel. Depth is the window depth of OpenGL (0 at the near plane, 1 at the far plane) and rows go bottom to top like NDC y.
+*/
+class CubeOcclusion
+{
+private:
+    // A triangle after setup: edge functions A * x + B * y + C at pixel centers, depth plane, and the pixels it can touch.
+    struct Triangle {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float zA, zB, zC;
+        int minX, maxX, minY, maxY;
+    };
+
+    struct Level {
+        int width, height;
+        std::vector<float> texels;
+    };
+
+    // A box has at most 3 faces, so 6 triangles, towards the camera.
+    static const int FRONT_TRIANGLES = 6;
+    static const int BAND_ROWS = 16;
+    // Cubes handled per job when testing.
+    static const uint32_t JOB_GRAIN = 4096;
+
+    int width{}, height{}, stride{};
+    // levels[0] is the depth buffer the occluders are drawn into, rows stride apart (width rounded up to the SIMD width).
+    std::vector<Level> levels;
+    std::vector<std::pair<float, uint32_t>> candidates;
+    std::vector<Triangle> triangles;
+    std::vector<uint8_t> triangleCounts;
+    std::vector<uint8_t> occludedFlags;
+    JobSystem* jobs{};
+
+    // Corners of the unit cube, bit 0 of the index is x, bit 1 y and bit 2 z. Every face as two triangles, counter clockwise seen
+    // from outside, so faces towards the camera keep that winding on screen (OpenGL's default front faces).
+    static glm::vec3 corner(int c) {
+        return glm::vec3((c & 1) ? 0.5f : -0.5f, (c & 2) ? 0.5f : -0.5f, (c & 4) ? 0.5f : -0.5f);
+    }
+
+    static const int* faceTriangles() {
+        static const int indices[36] = {
+            5, 1, 3, 5, 3, 7, // +x
+            0, 4, 6, 0, 6, 2, // -x
+            6, 7, 3, 6, 3, 2, // +y
+            0, 1, 5, 0, 5, 4, // -y
+            4, 5, 7, 4, 7, 6, // +z
+            1, 0, 2, 1, 2, 3  // -z
+        };
+        return indices;
+    }
+
+    // Pixel coordinates and window depth of the cube's corners. False if a corner is behind the near plane, the box is then partly
+    // behind the camera and no screen rectangle or depth of it can be trusted.
+    bool projectCorners(const glm::mat4& viewProj, const glm::vec3& center, glm::vec3 screen[8]) const {
+        glm::vec4 clipCenter = viewProj * glm::vec4(center, 1.0f);
+        for (int c = 0; c < 8; c++) {
+            glm::vec3 offset = corner(c);
+            glm::vec4 clip = clipCenter + viewProj[0] * offset.x + viewProj[1] * offset.y + viewProj[2] * offset.z;
+            if (clip.w <= 0.0f || clip.z < -clip.w)
+                return false;
+            float invW = 1.0f / clip.w;
+            screen[c] = glm::vec3((clip.x * invW * 0.5f + 0.5f) * width, (clip.y * invW * 0.5f + 0.5f) * height, clip.z * invW * 0.5f + 0.5f);
+        }
+        return true;
+    }
+
+    // Sets up the triangles of the occluder's faces that point at the camera, returns how many were written to out.
+    int setupOccluder(const glm::mat4& viewProj, const glm::vec3& center, Triangle* out) const {
+        glm::vec3 screen[8];
+        if (!projectCorners(viewProj, center, screen))
+            return 0;
+        const int* indices = faceTriangles();
+        int count = 0;
+        for (int t = 0; t < 12 && count < FRONT_TRIANGLES; t++) {
+            const glm::vec3& a = screen[indices[t * 3]];
+            const glm::vec3& b = screen[indices[t * 3 + 1]];
+            const glm::vec3& c = screen[indices[t * 3 + 2]];
+            float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+            // Facing away, or edge on.
+            if (area <= 1e-6f)
+                continue;
+            Triangle& tri = out[count];
+            const glm::vec3* v[3] = { &a, &b, &c };
+            for (int edge = 0; edge < 3; edge++) {
+                const glm::vec3& from = *v[edge];
+                const glm::vec3& to = *v[(edge + 1) % 3];
+                // Positive on the inner side. Moved in by half a pixel diagonal, so a pixel counts only if all of it is covered.
+                tri.edgeA[edge] = from.y - to.y;
+                tri.edgeB[edge] = to.x - from.x;
+                tri.edgeC[edge] = -(tri.edgeA[edge] * from.x + tri.edgeB[edge] * from.y) - 0.5f * (std::abs(tri.edgeA[edge]) + std::abs(tri.edgeB[edge]));
+            }
+            // Window depth is linear in screen space. Moved back by the most it changes within half a pixel, so every pixel gets the
+            // farthest depth the triangle has in it.
+            tri.zA = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+            tri.zB = ((b.x - a.x) * (c.z - a.z) - (c.x - a.x) * (b.z - a.z)) / area;
+            tri.zC = a.z - tri.zA * a.x - tri.zB * a.y + 0.5f * (std::abs(tri.zA) + std::abs(tri.zB));
+            tri.minX = std::max(0, (int)std::floor(std::min(std::min(a.x, b.x), c.x)));
+            tri.maxX = std::min(width - 1, (int)std::floor(std::max(std::max(a.x, b.x), c.x)));
+            tri.minY = std::max(0, (int)std::floor(std::min(std::min(a.y, b.y), c.y)));
+            tri.maxY = std::min(height - 1, (int)std::floor(std::max(std::max(a.y, b.y), c.y)));
+            if (tri.minX <= tri.maxX && tri.minY <= tri.maxY)
+                count++;
+        }
+        return count;
+    }
+
+    // Draws every set up triangle into rows [rowBegin, rowEnd) of the depth buffer.
+    void rasterizeBand(int rowBegin, int rowEnd, size_t occluders) {
+        float* depth = levels[0].texels.data();
+        std::fill(depth + (size_t)rowBegin * stride, depth + (size_t)rowEnd * stride, 1.0f);
+        for (size_t o = 0; o < occluders; o++) {
+            for (int t = 0; t < triangleCounts[o]; t++) {
+                const Triangle& tri = triangles[o * FRONT_TRIANGLES + t];
+                int y0 = std::max(tri.minY, rowBegin), y1 = std::min(tri.maxY, rowEnd - 1);
+                // Spans start and end on multiples of 8 so the SIMD versions only ever see whole registers, stride leaves room for that.
+                int x0 = tri.minX & ~7, x1 = (tri.maxX + 8) & ~7;
+                float cx = x0 + 0.5f;
+                for (int y = y0; y <= y1; y++) {
+                    float cy = y + 0.5f;
+                    float e[3];
+                    for (int edge = 0; edge < 3; edge++)
+                        e[edge] = tri.edgeA[edge] * cx + tri.edgeB[edge] * cy + tri.edgeC[edge];
+                    rasterizeSpan(depth + (size_t)y * stride, x0, x1, e, tri.edgeA, tri.zA * cx + tri.zB * cy + tri.zC, tri.zA);
+                }
+            }
+        }
+    }
+
+    // Every level keeps the farthest depth of the 2x2 texels below it. Odd sizes round up, the missing texels repeat the last ones.
+    void buildPyramid() {
+        for (size_t l = 1; l < levels.size(); l++) {
+            const Level& below = levels[l - 1];
+            Level& level = levels[l];
+            int belowStride = l == 1 ? stride : below.width;
+            for (int y = 0; y < level.height; y++) {
+                int y0 = y * 2, y1 = std::min(y * 2 + 1, below.height - 1);
+                for (int x = 0; x < level.width; x++) {
+                    int x0 = x * 2, x1 = std::min(x * 2 + 1, below.width - 1);
+                    level.texels[(size_t)y * level.width + x] = std::max(
+                        std::max(below.texels[(size_t)y0 * belowStride + x0], below.texels[(size_t)y0 * belowStride + x1]),
+                        std::max(below.texels[(size_t)y1 * belowStride + x0], below.texels[(size_t)y1 * belowStride + x1]));
+                }
+            }
+        }
+    }
+
+public:
+    // At most this many of the nearest cubes are drawn as occluders each frame.
+    uint32_t maxOccluders{ 1024 };
+    // Statistics of the last cull() call.
+    unsigned int occluderCount{};
+    unsigned int occludedCount{};
+
+    // width and height of the depth buffer in pixels, only the aspect ratio has to match the screen.
+    CubeOcclusion(int width = 256, int height = 192, JobSystem* jobs = nullptr) : width(width), height(height), jobs(jobs) {
+        stride = (width + 7) & ~7;
+        int w = width, h = height;
+        levels.push_back(Level{ w, h, std::vector<float>((size_t)stride * h, 1.0f) });
+        while (w > 1 || h > 1) {
+            w = (w + 1) / 2;
+            h = (h + 1) / 2;
+            levels.push_back(Level{ w, h, std::vector<float>((size_t)w * h, 1.0f) });
+        }
+    }
+
+    // Removes the cubes hidden behind others from cubes (indices into the world, usually what's left after frustum culling), keeping
+    // the order of the rest. alpha and viewProj have to be the ones the cubes are drawn with, viewPos picks the nearest occluders.
+    void cull(const CubeWorld& world, float alpha, const glm::mat4& viewProj, const glm::vec3& viewPos, std::vector<uint32_t>& cubes) {
+        occluderCount = 0;
+        occludedCount = 0;
+        if (cubes.empty())
+            return;
+
+        candidates.resize(cubes.size());
+        for (size_t k = 0; k < cubes.size(); k++) {
+            glm::vec3 d = world.interpolatedPosition(cubes[k], alpha) - viewPos;
+            candidates[k] = std::make_pair(glm::dot(d, d), cubes[k]);
+        }
+        size_t occluders = std::min<size_t>(maxOccluders, candidates.size());
+        if (occluders < candidates.size())
+            std::nth_element(candidates.begin(), candidates.begin() + occluders, candidates.end());
+        occluderCount = (unsigned int)occluders;
+
+        triangles.resize(occluders * FRONT_TRIANGLES);
+        triangleCounts.resize(occluders);
+        parallelFor(jobs, (uint32_t)occluders, 64, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t o = begin; o < end; o++)
+                triangleCounts[o] = (uint8_t)setupOccluder(viewProj, world.interpolatedPosition(candidates[o].second, alpha), &triangles[o * FRONT_TRIANGLES]);
+        });
+        uint32_t bands = (uint32_t)((height + BAND_ROWS - 1) / BAND_ROWS);
+        parallelFor(jobs, bands, 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t band = begin; band < end; band++)
+                rasterizeBand((int)band * BAND_ROWS, std::min(height, (int)(band + 1) * BAND_ROWS), occluders);
+        });
+        // The pyramid is a third of the size of the depth buffer, not worth splitting over jobs.
+        buildPyramid();
+
+        occludedFlags.resize(cubes.size());
+        parallelFor(jobs, (uint32_t)cubes.size(), JOB_GRAIN, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t k = begin; k < end; k++)
+                occludedFlags[k] = occluded(viewProj, world.interpolatedPosition(cubes[k], alpha)) ? 1 : 0;
+        });
+        size_t kept = 0;
+        for (size_t k = 0; k < cubes.size(); k++) {
+            if (!occludedFlags[k])
+                cubes[kept++] = cubes[k];
+        }
+        occludedCount = (unsigned int)(cubes.size() - kept);
+        cubes.resize(kept);
+    }
+
+    // Whether the unit cube at center is hidden according to the depth buffer of the last cull() call.
+    bool occluded(const glm::mat4& viewProj, const glm::vec3& center) const {
+        glm::vec3 screen[8];
+        if (!projectCorners(viewProj, center, screen))
+            return false;
+        glm::vec3 lo = screen[0], hi = screen[0];
+        for (int c = 1; c < 8; c++) {
+            lo = glm::min(lo, screen[c]);
+            hi = glm::max(hi, screen[c]);
+        }
+        // Every pixel the box's screen rectangle touches.
+        int x0 = std::max(0, (int)std::floor(lo.x)), x1 = std::min(width - 1, (int)std::floor(hi.x));
+        int y0 = std::max(0, (int)std::floor(lo.y)), y1 = std::min(height - 1, (int)std::floor(hi.y));
+        if (x0 > x1 || y0 > y1)
+            return false;
+        // The first level where the rectangle is at most 2x2 texels, a texel of level l covers 2^l pixels on each side.
+        size_t l = 0;
+        while ((x1 >> l) - (x0 >> l) > 1 || (y1 >> l) - (y0 >> l) > 1)
+            l++;
+        const Level& level = levels[l];
+        int levelStride = l == 0 ? stride : level.width;
+        float farthest = 0.0f;
+        for (int y = y0 >> l; y <= (y1 >> l); y++) {
+            for (int x = x0 >> l; x <= (x1 >> l); x++)
+                farthest = std::max(farthest, level.texels[(size_t)y * levelStride + x]);
+        }
+        return lo.z > farthest;
+    }
+};
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef CUBE_RAYCAST_H
+#define CUBE_RAYCAST_H
+
+#include "glm/glm.hpp"
+#include "CubeSimd.h"
+#include <limits>
+#include <algorithm>
+
+// Number of cubes tested per loop iteration. The position arrays passed to raycastCubes have to stay readable up to count rounded up to
+// a multiple of this, the lanes past count are loaded but masked out.
+const int RAYCAST_BATCH = 8;
+
+// Index into the arrays that were searched and distance along the ray, index is -1 if nothing was hit.
+struct CubeRayHit {
+    int index = -1;
+    float t = std::numeric_limits<float>::max();
+};
+
+// 1 / dir, with divisions by zero clamped to a huge finite value. Infinity would turn into NaN in the slab test when multiplied by 0.
+inline glm::vec3 rayInverseDirection(const glm::vec3& dir) {
+    glm::vec3 invDir;
+    for (int axis = 0; axis < 3; axis++)
+        invDir[axis] = dir[axis] != 0.0f ? 1.0f / dir[axis] : std::numeric_limits<float>::max();
+    return invDir;
+}
+
+/* Ray against count unit cubes whose centers are given as separate x, y and z arrays. Returns the closest cube the ray enters at
+*  0 <= t < maxT. Cubes that contain the origin are skipped, the player can't target the cube they're standing in. On equal t the lower index wins.
+*  This is the reference every SIMD version has to agree with.
+*/
+inline CubeRayHit raycastCubesScalar(const float* x, const float* y, const float* z, int count, const glm::vec3& origin, const glm::vec3& invDir, float maxT) {
+    CubeRayHit hit;
+    hit.t = maxT;
+    const float* centers[3] = { x, y, z };
+    for (int i = 0; i < count; i++) {
+        float tmin = -std::numeric_limits<float>::max(), tmax = hit.t;
+        for (int axis = 0; axis < 3; axis++) {
+            float t1 = (centers[axis][i] - 0.5f - origin[axis]) * invDir[axis];
+            float t2 = (centers[axis][i] + 0.5f - origin[axis]) * invDir[axis];
+            tmin = std::max(tmin, std::min(t1, t2));
+            tmax = std::min(tmax, std::max(t1, t2));
+        }
+        if (tmin <= tmax && tmin >= 0.0f && tmin < hit.t) {
+            hit.t = tmin;
+            hit.index = i;
+        }
+    }
+    if (hit.index < 0)
+        hit.t = std::numeric_limits<float>::max();
+    return hit;
+}
+
+#if defined(CUBE_SIMD_AVX2)
+
+inline CubeRayHit raycastCubes(const float* x, const float* y, const float* z, int count, const glm::vec3& origin, const glm::vec3& invDir, float maxT) {
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 o[3] = { _mm256_set1_ps(origin.x), _mm256_set1_ps(origin.y), _mm256_set1_ps(origin.z) };
+    const __m256 inv[3] = { _mm256_set1_ps(invDir.x), _mm256_set1_ps(invDir.y), _mm256_set1_ps(invDir.z) };
+    const __m256i countVec = _mm256_set1_epi32(count);
+    const float* centers[3] = { x, y, z };
+
+    // Every lane keeps its own closest hit, they're only compared against each other at the end.
+    __m256 bestT = _mm256_set1_ps(maxT);
+    __m256i bestIndex = _mm256_set1_epi32(-1);
+    __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (int i = 0; i < count; i += 8) {
+        __m256 tmin = _mm256_set1_ps(-std::numeric_limits<float>::max());
+        __m256 tmax = bestT;
+        for (int axis = 0; axis < 3; axis++) {
+            __m256 c = _mm256_loadu_ps(centers[axis] + i);
+            __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(c, half), o[axis]), inv[axis]);
+            __m256 t2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(c, half), o[axis]), inv[axis]);
+            tmin = _mm256_max_ps(tmin, _mm256_min_ps(t1, t2));
+            tmax = _mm256_min_ps(tmax, _mm256_max_ps(t1, t2));
+        }
+        __m256 hit = _mm256_and_ps(_mm256_cmp_ps(tmin, tmax, _CMP_LE_OQ), _mm256_cmp_ps(tmin, zero, _CMP_GE_OQ));
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(tmin, bestT, _CMP_LT_OQ));
+        hit = _mm256_and_ps(hit, _mm256_castsi256_ps(_mm256_cmpgt_epi32(countVec, index)));
+        bestT = _mm256_blendv_ps(bestT, tmin, hit);
+        bestIndex = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(bestIndex), _mm256_castsi256_ps(index), hit));
+        index = _mm256_add_epi32(index, _mm256_set1_epi32(8));
+    }
+
+    alignas(32) float laneT[8];
+    alignas(32) int laneIndex[8];
+    _mm256_store_ps(laneT, bestT);
+    _mm256_store_si256((__m256i*)laneIndex, bestIndex);
+    CubeRayHit result;
+    for (int lane = 0; lane < 8; lane++) {
+        if (laneIndex[lane] >= 0 && (laneT[lane] < result.t || (laneT[lane] == result.t && laneIndex[lane] < result.index))) {
+            result.t = laneT[lane];
+            result.index = laneIndex[lane];
+        }
+    }
+    return result;
+}
+
+#elif defined(CUBE_SIMD_SSE2)
+
+inline CubeRayHit raycastCubes(const float* x, const float* y, const float* z, int count, const glm::vec3& origin, const glm::vec3& invDir, float maxT) {
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 o[3] = { _mm_set1_ps(origin.x), _mm_set1_ps(origin.y), _mm_set1_ps(origin.z) };
+    const __m128 inv[3] = { _mm_set1_ps(invDir.x), _mm_set1_ps(invDir.y), _mm_set1_ps(invDir.z) };
+    const __m128i countVec = _mm_set1_epi32(count);
+    const float* centers[3] = { x, y, z };
+
+    // Two independent groups of 4 lanes per iteration, so a whole RAYCAST_BATCH is handled per loop like with AVX2.
+    __m128 bestT[2] = { _mm_set1_ps(maxT), _mm_set1_ps(maxT) };
+    __m128i bestIndex[2] = { _mm_set1_epi32(-1), _mm_set1_epi32(-1) };
+    __m128i index[2] = { _mm_setr_epi32(0, 1, 2, 3), _mm_setr_epi32(4, 5, 6, 7) };
+
+    for (int i = 0; i < count; i += 8) {
+        for (int g = 0; g < 2; g++) {
+            __m128 tmin = _mm_set1_ps(-std::numeric_limits<float>::max());
+            __m128 tmax = bestT[g];
+            for (int axis = 0; axis < 3; axis++) {
+                __m128 c = _mm_loadu_ps(centers[axis] + i + g * 4);
+                __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(c, half), o[axis]), inv[axis]);
+                __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(c, half), o[axis]), inv[axis]);
+                tmin = _mm_max_ps(tmin, _mm_min_ps(t1, t2));
+                tmax = _mm_min_ps(tmax, _mm_max_ps(t1, t2));
+            }
+            __m128 hit = _mm_and_ps(_mm_cmple_ps(tmin, tmax), _mm_cmpge_ps(tmin, zero));
+            hit = _mm_and_ps(hit, _mm_cmplt_ps(tmin, bestT[g]));
+            hit = _mm_and_ps(hit, _mm_castsi128_ps(_mm_cmpgt_epi32(countVec, index[g])));
+            // SSE2 has no blend, select with and/andnot/or.
+            bestT[g] = _mm_or_ps(_mm_and_ps(hit, tmin), _mm_andnot_ps(hit, bestT[g]));
+            __m128i hitInt = _mm_castps_si128(hit);
+            bestIndex[g] = _mm_or_si128(_mm_and_si128(hitInt, index[g]), _mm_andnot_si128(hitInt, bestIndex[g]));
+            index[g] = _mm_add_epi32(index[g], _mm_set1_epi32(8));
+        }
+    }
+
+    alignas(16) float laneT[8];
+    alignas(16) int laneIndex[8];
+    _mm_store_ps(laneT, bestT[0]);
+    _mm_store_ps(laneT + 4, bestT[1]);
+    _mm_store_si128((__m128i*)laneIndex, bestIndex[0]);
+    _mm_store_si128((__m128i*)(laneIndex + 4), bestIndex[1]);
+    CubeRayHit result;
+    for (int lane = 0; lane < 8; lane++) {
+        if (laneIndex[lane] >= 0 && (laneT[lane] < result.t || (laneT[lane] == result.t && laneIndex[lane] < result.index))) {
+            result.t = laneT[lane];
+            result.index = laneIndex[lane];
+        }
+    }
+    return result;
+}
+
+#else
+
+inline CubeRayHit raycastCubes(const float* x, const float* y, const float* z, int count, const glm::vec3& origin, const glm::vec3& invDir, float maxT) {
+    return raycastCubesScalar(x, y, z, count, origin, invDir, maxT);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef CUBE_RENDERER_H
+#define CUBE_RENDERER_H
+
+#include <glad/glad.h>
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "Cube.h"
+#include "VertexFormat.h"
+#include "CubeWorld.h"
+#include "CubeCulling.h"
+#include "CubeOcclusion.h"
+#include <vector>
+#include <cstddef>
+#include <iostream>
+#include "TextureCache.h"
+#include "JobSystem.h"
+
+// Everything the vertex shader needs to know about one cube, uploaded once per frame for all cubes at once.
+struct CubeInstance {
+    // Translation, rotation and uniform scale only, vLightShader transforms normals with it directly instead of its inverse transpose.
+    glm::mat4 model;
+    // 0 = default, 1 = targeted (red), 2 = moving (blue). Read as the "Color" varying in fLightShader.
+    int color;
+};
+
+/* Draws every cube in view with a single instanced draw call. The cube mesh and the textures only exist once on the GPU,
+*  the only thing that differs between cubes (model matrix and highlight state) is streamed through a per-instance
+*  vertex buffer that gets refilled every frame.
+*/
+class CubeRenderer
+{
+private:
+    unsigned int instanceVBO{};
+    unsigned int texture0{}, texture1{}, texture2{};
+    // Where the textures came from, they're given back to it in the destructor.
+    TextureCache* textures{};
+    // CPU side staging copy of the instance buffer, kept around so it doesn't have to be reallocated every frame.
+    std::vector<CubeInstance> instances;
+    size_t instanceCapacity{};
+    // Frustum test result of every cube, and the indices of the ones that passed and aren't hidden behind others, see draw().
+    std::vector<uint8_t> cullFlags;
+    std::vector<uint32_t> visibleCubes;
+    CubeOcclusion occlusion;
+    // Depth bucket of every visible cube for the front to back ordering, and where in instances it ends up.
+    std::vector<unsigned char> depthKeys;
+    std::vector<unsigned int> drawSlots;
+    // Splits the per cube passes of draw() over all cores, nullptr runs them on the calling thread.
+    JobSystem* jobs{};
+
+public:
+    // Cubes are drawn front to back in DRAW_ORDER_BUCKETS slices of DRAW_ORDER_RANGE depth (the far plane), anything farther goes into the last one.
+    static const int DRAW_ORDER_BUCKETS = 256;
+    static constexpr float DRAW_ORDER_RANGE = 100.0f;
+    // Cubes handled per job in the parallel passes of draw().
+    static const uint32_t JOB_GRAIN = 16384;
+
+    // Shared cube mesh (24 vertices and 36 indices, see Cube.h), also used by main to draw the light cube with the plain shader.
+    unsigned int VBO{}, EBO{}, VAO{};
+    VertexFormat vertexFormat{};
+    // Scale the mesh has to be drawn with to come out as a unit cube. The compact format stores the corners at +-1 instead of +-0.5,
+    // since 0.5 isn't exact in snorm16 and +-1 is, so the model matrices of the instances (and main's light cube) scale it by 0.5.
+    float meshScale{ 1.0f };
+    // GPU memory of the cube mesh.
+    size_t vertexBytes{}, indexBytes{};
+    // Statistics of the last draw() call.
+    unsigned int drawCalls{};
+    unsigned int instanceCount{};
+    unsigned int visibleCount{};
+    unsigned int culledCount{};
+    unsigned int occludedCount{};
+    // Skips cubes hidden behind nearer ones, see CubeOcclusion. Off draws everything in the frustum.
+    bool occlusionCulling{ true };
+
+    // The material textures come from the shared cache, so additional renderers (or anything else using the same images) don't decode them again.
+    CubeRenderer(TextureCache& textures, JobSystem* jobs = nullptr, VertexFormat format = COMPACT_VERTICES) : textures(&textures), occlusion(256, 192, jobs), jobs(jobs), vertexFormat(format) {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glGenBuffers(1, &instanceVBO);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        if (vertexFormat == COMPACT_VERTICES) {
+            // Packed at twice the size so the corners land exactly on +-1, the 0.5 is applied by the instance transform (see meshScale).
+            meshScale = 0.5f;
+            std::vector<CompactVertex> packed = packVertices(cubeVertices, CUBE_VERTEX_COUNT, 1.0f / meshScale);
+            vertexBytes = packed.size() * sizeof(CompactVertex);
+            glBufferData(GL_ARRAY_BUFFER, vertexBytes, packed.data(), GL_STATIC_DRAW);
+            // Normalized, so the shaders still see floats in [-1, 1] and [0, 1].
+            glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, position));
+            glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, normal));
+            glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, uv));
+        }
+        else {
+            vertexBytes = sizeof(cubeVertices);
+            glBufferData(GL_ARRAY_BUFFER, vertexBytes, cubeVertices, GL_STATIC_DRAW);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+        }
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glEnableVertexAttribArray(2);
+        // The element buffer binding is part of the VAO, so binding the VAO is all a draw needs.
+        indexBytes = sizeof(cubeIndices);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, cubeIndices, GL_STATIC_DRAW);
+
+        // A mat4 attribute takes up four consecutive locations (3 to 6), one per column. The divisor makes them advance once per cube instead of once per vertex.
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        for (int i = 0; i < 4; i++) {
+            glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(CubeInstance), (void*)(offsetof(CubeInstance, model) + i * sizeof(glm::vec4)));
+            glEnableVertexAttribArray(3 + i);
+            glVertexAttribDivisor(3 + i, 1);
+        }
+        glVertexAttribIPointer(7, 1, GL_INT, sizeof(CubeInstance), (void*)offsetof(CubeInstance, color));
+        glEnableVertexAttribArray(7);
+        glVertexAttribDivisor(7, 1);
+
+        glBindVertexArray(0);
+
+        texture0 = textures.acquire("diamond.jpg");
+        texture1 = textures.acquire("diamondSpec.jpg");
+        texture2 = textures.acquire("diamondEmit.jpg");
+    }
+
+    // Size of the cube mesh on the GPU, next to what the float layout would take.
+    void printMeshStats() const {
+        std::cout << "CubeRenderer: cube mesh " << (vertexFormat == COMPACT_VERTICES ? "compact" : "float") << ", " << CUBE_VERTEX_COUNT << " vertices x "
+            << vertexBytes / CUBE_VERTEX_COUNT << " bytes = " << vertexBytes << " bytes, " << CUBE_INDEX_COUNT << " indices = " << indexBytes
+            << " bytes, " << vertexBytes + indexBytes << " bytes total (float vertices: " << sizeof(cubeVertices) + indexBytes << ")" << std::endl;
+    }
+
+    // Has to run while the GL context is still alive, and before the TextureCache goes away.
+    ~CubeRenderer() {
+        textures->release(texture0);
+        textures->release(texture1);
+        textures->release(texture2);
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteBuffers(1, &instanceVBO);
+    }
+
+    CubeRenderer(const CubeRenderer&) = delete;
+    CubeRenderer& operator=(const CubeRenderer&) = delete;
+
+    // Draws the cubes inside the frustum of viewProj (proj * view) with whatever shader is currently in use, which has to read the
+    // instance attributes (see vLightShader.txt). Roughly front to back as seen from viewPos looking along viewDir, so the depth test
+    // can throw away hidden fragments early. alpha blends between the last two physics steps, see CubeWorld::interpolatedPosition.
+    void draw(const CubeWorld& world, float alpha, const glm::vec3& viewPos, const glm::vec3& viewDir, const glm::mat4& viewProj) {
+        size_t total = world.size();
+        drawCalls = 0;
+        instanceCount = 0;
+        visibleCount = 0;
+        culledCount = 0;
+        occludedCount = 0;
+        if (total == 0)
+            return;
+
+        // Cubes outside the frustum are dropped before anything else looks at them, and then the ones hidden behind nearer cubes, so
+        // everything after this (sorting, filling and uploading instances, and the vertex and fragment work on the GPU) only costs as
+        // much as the cubes that can actually be seen.
+        frustumCullWorld(world, CubeFrustum(viewProj), jobs, JOB_GRAIN, cullFlags, visibleCubes);
+        culledCount = (unsigned int)(total - visibleCubes.size());
+        if (occlusionCulling) {
+            occlusion.cull(world, alpha, viewProj, viewPos, visibleCubes);
+            occludedCount = occlusion.occludedCount;
+        }
+        size_t count = visibleCubes.size();
+        visibleCount = (unsigned int)count;
+        instanceCount = visibleCount;
+        if (count == 0)
+            return;
+
+        /* The order only has to be good enough for early depth rejection, so instead of sorting by exact distance every cube gets
+        *  a one byte key from its depth along the view direction (one dot product, no square root), and the instances are
+        *  counting sorted by that key. Linear in the number of cubes.
+        */
+        depthKeys.resize(count);
+        const float scale = DRAW_ORDER_BUCKETS / DRAW_ORDER_RANGE;
+        parallelFor(jobs, (uint32_t)count, JOB_GRAIN, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t k = begin; k < end; k++) {
+                uint32_t i = visibleCubes[k];
+                float depth = ((world.posX[i] - viewPos.x) * viewDir.x + (world.posY[i] - viewPos.y) * viewDir.y + (world.posZ[i] - viewPos.z) * viewDir.z) * scale;
+                int key = depth <= 0.0f ? 0 : (depth >= DRAW_ORDER_BUCKETS - 1 ? DRAW_ORDER_BUCKETS - 1 : (int)depth);
+                depthKeys[k] = (unsigned char)key;
+            }
+        });
+
+        // Histogram and prefix sum stay on one thread, they only touch one byte per cube.
+        unsigned int offsets[DRAW_ORDER_BUCKETS] = {};
+        for (size_t i = 0; i < count; i++)
+            offsets[depthKeys[i]]++;
+        unsigned int sum = 0;
+        for (int b = 0; b < DRAW_ORDER_BUCKETS; b++) {
+            unsigned int bucketSize = offsets[b];
+            offsets[b] = sum;
+            sum += bucketSize;
+        }
+        drawSlots.resize(count);
+        for (size_t i = 0; i < count; i++)
+            drawSlots[i] = offsets[depthKeys[i]]++;
+
+        // Every cube has its own slot now, so the matrices can be written from any thread.
+        instances.resize(count);
+        parallelFor(jobs, (uint32_t)count, JOB_GRAIN, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t k = begin; k < end; k++) {
+                uint32_t i = visibleCubes[k];
+                CubeInstance& instance = instances[drawSlots[k]];
+                instance.model = glm::mat4(meshScale);
+                instance.model[3] = glm::vec4(world.interpolatedPosition(i, alpha), 1.0f);
+                // Moving takes precedence over targeted, same as the old per-cube color uniform.
+                instance.color = (world.flags[i] & CUBE_MOVING) ? 2 : ((world.flags[i] & CUBE_TARGETED) ? 1 : 0);
+            }
+        });
+
+        // Re-specifying the storage every frame orphans last frame's buffer, so the driver doesn't stall waiting on the previous draw.
+        // The capacity is doubled on growth so spawning cubes one at a time doesn't change the allocation size every frame.
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        if (instances.size() > instanceCapacity) {
+            instanceCapacity = instances.size() * 2;
+        }
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(CubeInstance), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(CubeInstance), instances.data());
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, texture1);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, texture2);
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, CUBE_INDEX_COUNT, GL_UNSIGNED_SHORT, (void*)0, (GLsizei)instances.size());
+        drawCalls = 1;
+    }
+};
+
+#endif
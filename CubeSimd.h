@@ -0,0 +1,23 @@
+#ifndef CUBE_SIMD_H
+#define CUBE_SIMD_H
+
+// Picks the widest instruction set the compiler is allowed to use for every SIMD kernel (CubeRaycast, CubeIntegrate, CubeCulling,
+// CubeOcclusion), so they all agree. MSVC only defines __AVX2__ with /arch:AVX2 and always has SSE2 on x64.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CUBE_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CUBE_SIMD_SSE2
+#endif
+
+// Name of the instruction set picked above, for benchmarks to print.
+#if defined(CUBE_SIMD_AVX2)
+const char* const CUBE_SIMD_NAME = "AVX2";
+#elif defined(CUBE_SIMD_SSE2)
+const char* const CUBE_SIMD_NAME = "SSE2";
+#else
+const char* const CUBE_SIMD_NAME = "scalar";
+#endif
+
+#endif
@@ -0,0 +1,474 @@
+#ifndef CUBE_SOLVER_H
+#define CUBE_SOLVER_H
+
+#include "glm/glm.hpp"
+#include "CubeWorld.h"
+#include "CubeGrid.h"
+#include "JobSystem.h"
+#include "CubeIntegrate.h"
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Downwards acceleration of falling cubes in units per second squared.
+const float CUBE_GRAVITY = 25.0f;
+
+/* Moves the falling cubes by one physics step and keeps them from going through each other and the ground.
+*
+*  Every cube is an axis aligned unit box, so the contact between two of them is simple: the normal is the axis along which they
+*  overlap the least, and the penetration is how much they overlap along it. The ground is just one more contact, with a body that never moves.
+*  Contacts are resolved with sequential impulses: a few passes over all contacts, each applying whatever impulse is still needed to
+*  stop the cubes from approaching (plus a bit of bounce and friction). Accumulated impulses are clamped, so later passes can take back
+*  what earlier ones overdid. Leftover penetration is pushed out directly afterwards.
+*
+*  Only awake cubes (flagged CUBE_MOVING) are simulated. Every other cube (sleeping, held, the light cube) acts as an immovable body
+*  with whatever velocity it has, so a held cube can still shove falling cubes around.
+*
+*  Awake cubes that touch each other form an island. Once every cube of an island has been slower than SLEEP_SPEED for SLEEP_TIME,
+*  the whole island goes to sleep together and drops out of the simulation. A stack only sleeps once all of it is calm, so a cube
+*  isn't frozen while the one below it still slides. Sleeping cubes remember their island, and an awake cube touching any of them
+*  (or the player grabbing one) wakes all of it again. Integration and contacts only ever look at awake cubes and their direct
+*  neighbors, which the grid finds in the cells around each awake cube, so a step costs as much as the awake part of the world no
+*  matter how many cubes sleep.
+*
+*  Cubes thrown fast enough to cross half a cube per step are swept along their path and stopped at the first box they would run into,
+*  so they can't tunnel through other cubes or the ground. Only those cubes pay for the sweep.
+*
+*  The awake cubes and their neighbors are copied into packed arrays at the start of a step and written back at the end, so gravity
+*  and integration are SIMD loops over contiguous floats instead of gathers all over the world's arrays.
+*
+*  step() doesn't allocate once its buffers have grown to the largest number of contacts and cubes seen so far.
+*/
+class CubeSolver
+{
+private:
+    // Dense index of the ground body in Contact::b.
+    static constexpr uint32_t GROUND = 0xFFFFFFFFu;
+
+    struct Contact {
+        // Packed body indices, the normal points from b to a.
+        uint32_t a, b;
+        int axis;
+        float sign;
+        // Separating speed the solver aims for, > 0 when the cubes should bounce.
+        float bounce;
+        float normalImpulse;
+        glm::vec3 frictionImpulse;
+    };
+
+    // The cubes taking part in this step, copied out of the world into packed arrays so integration runs over contiguous memory
+    // (see CubeIntegrate.h). The first awakeCount entries are the awake cubes, after them come the cubes they touch, with an inverse
+    // mass of 0. bodies holds the dense world index of every entry.
+    std::vector<uint32_t> bodies;
+    std::vector<float> bodyX, bodyY, bodyZ;
+    std::vector<float> bodyVX, bodyVY, bodyVZ;
+    std::vector<float> bodyInvMass;
+    // Packed index of every dense world index, only valid where bodyStamp matches stamp, so it never has to be cleared.
+    std::vector<uint32_t> bodyOf;
+    std::vector<uint32_t> bodyStamp;
+    uint32_t stamp{};
+    std::vector<Contact> contacts;
+    std::vector<CubeHandle> toWake;
+    // Awake bodies that would hit something during this step without ever touching it at a step boundary, and how far into the step.
+    struct Impact {
+        uint32_t body;
+        float time;
+    };
+    std::vector<Impact> impacts;
+    // Union find over the awake bodies, and the smallest sleep timer / first sleeping cube of each island root.
+    std::vector<uint32_t> islandParent;
+    std::vector<float> islandTimer;
+    std::vector<uint32_t> islandHead;
+
+    // Per handle slot, since dense indices change on despawn. How long the cube has been slow, and the next cube of its island while
+    // it sleeps (the members form a ring). An invalid handle means the cube sleeps alone.
+    std::vector<float> sleepTimer;
+    std::vector<CubeHandle> islandNext;
+
+    // Integration is spread over all cores, contacts are solved on the calling thread since every pass depends on the one before.
+    JobSystem* jobs{};
+
+    uint32_t findIsland(uint32_t k) {
+        while (islandParent[k] != k) {
+            islandParent[k] = islandParent[islandParent[k]];
+            k = islandParent[k];
+        }
+        return k;
+    }
+
+    void growPerSlot(const CubeWorld& world) {
+        if (sleepTimer.size() < world.slotCount()) {
+            sleepTimer.resize(world.slotCount(), 0.0f);
+            islandNext.resize(world.slotCount());
+        }
+    }
+
+    // Packed index of the world cube i, copying it in first if this step hasn't seen it yet.
+    uint32_t addBody(const CubeWorld& world, uint32_t i, float invMass) {
+        if (bodyStamp[i] == stamp)
+            return bodyOf[i];
+        bodyStamp[i] = stamp;
+        bodyOf[i] = (uint32_t)bodies.size();
+        bodies.push_back(i);
+        bodyX.push_back(world.posX[i]);
+        bodyY.push_back(world.posY[i]);
+        bodyZ.push_back(world.posZ[i]);
+        bodyVX.push_back(world.velX[i]);
+        bodyVY.push_back(world.velY[i]);
+        bodyVZ.push_back(world.velZ[i]);
+        bodyInvMass.push_back(invMass);
+        return bodyOf[i];
+    }
+
+    float inverseMass(uint32_t k) const {
+        return k == GROUND ? 0.0f : bodyInvMass[k];
+    }
+
+    glm::vec3 bodyPosition(uint32_t k) const {
+        return glm::vec3(bodyX[k], bodyY[k], bodyZ[k]);
+    }
+
+    glm::vec3 bodyVelocity(uint32_t k) const {
+        return k == GROUND ? glm::vec3(0.0f) : glm::vec3(bodyVX[k], bodyVY[k], bodyVZ[k]);
+    }
+
+    void addBodyVelocity(uint32_t k, const glm::vec3& dv) {
+        bodyVX[k] += dv.x;
+        bodyVY[k] += dv.y;
+        bodyVZ[k] += dv.z;
+    }
+
+    void addContact(uint32_t a, uint32_t b, int axis, float sign) {
+        Contact c{ a, b, axis, sign, 0.0f, 0.0f, glm::vec3(0.0f) };
+        float approach = (bodyVelocity(a)[axis] - bodyVelocity(b)[axis]) * sign;
+        if (approach < -BOUNCE_THRESHOLD)
+            c.bounce = -approach * RESTITUTION;
+        contacts.push_back(c);
+    }
+
+    // Overlap of the contact along its normal, negative if the cubes have separated.
+    float penetration(const Contact& c) const {
+        float pa = bodyPosition(c.a)[c.axis];
+        if (c.b == GROUND)
+            return HALF_EXTENT - pa;
+        return 2.0f * HALF_EXTENT - (pa - bodyPosition(c.b)[c.axis]) * c.sign;
+    }
+
+    void solveVelocity(Contact& c) {
+        float invA = inverseMass(c.a), invB = inverseMass(c.b);
+        float invSum = invA + invB;
+        if (invSum == 0.0f)
+            return;
+        glm::vec3 normal(0.0f);
+        normal[c.axis] = c.sign;
+
+        glm::vec3 relative = bodyVelocity(c.a) - bodyVelocity(c.b);
+        float vn = glm::dot(relative, normal);
+        float impulse = (c.bounce - vn) / invSum;
+        float total = std::max(c.normalImpulse + impulse, 0.0f);
+        impulse = total - c.normalImpulse;
+        c.normalImpulse = total;
+        glm::vec3 p = normal * impulse;
+
+        // Friction opposes the sliding velocity, limited by how hard the cubes are pressed together.
+        relative += p * invSum;
+        glm::vec3 tangent = relative - normal * glm::dot(relative, normal);
+        glm::vec3 friction = c.frictionImpulse - tangent / invSum;
+        float maxFriction = FRICTION * c.normalImpulse;
+        float length = glm::length(friction);
+        if (length > maxFriction)
+            friction *= maxFriction / length;
+        p += friction - c.frictionImpulse;
+        c.frictionImpulse = friction;
+
+        addBodyVelocity(c.a, p * invA);
+        if (invB > 0.0f)
+            addBodyVelocity(c.b, -p * invB);
+    }
+
+    // Calls f(other) with every cube whose box touches or overlaps the box of cube, centered at center.
+    template<typename F>
+    static void forEachTouching(const CubeGrid& grid, CubeHandle cube, const glm::vec3& center, F f) {
+        grid.forEachInBox(center - glm::vec3(HALF_EXTENT), center + glm::vec3(HALF_EXTENT), [&](CubeHandle other) {
+            if (other != cube)
+                f(other);
+        });
+    }
+
+    /* Fraction of this step the awake body k can move before its box runs into one it doesn't touch yet, 1 if it hits nothing.
+    *  The path is swept in pieces of at most one cube length, so a long diagonal throw asks the grid for a chain of small boxes
+    *  rather than one huge one, and the sweep ends with the first piece that hits something. Other cubes are taken where they are at
+    *  the start of the step, moving along with their own velocity. Cubes already touching are left to the contacts.
+    */
+    float timeOfImpact(const CubeWorld& world, const CubeGrid& grid, uint32_t k, float dTime) const {
+        glm::vec3 start = bodyPosition(k);
+        glm::vec3 move = bodyVelocity(k) * dTime;
+        CubeHandle self = world.handleOf(bodies[k]);
+        float toi = 1.0f;
+        if (move.y < 0.0f && start.y > HALF_EXTENT)
+            toi = std::min(toi, (HALF_EXTENT - start.y) / move.y);
+
+        int pieces = std::min((int)std::ceil(glm::length(move) / (2.0f * HALF_EXTENT)), MAX_SWEEP_PIECES);
+        for (int piece = 0; piece < pieces && (float)piece / pieces < toi; piece++) {
+            glm::vec3 from = start + move * ((float)piece / pieces);
+            glm::vec3 to = start + move * std::min((float)(piece + 1) / pieces, toi);
+            grid.forEachInBox(glm::min(from, to) - glm::vec3(HALF_EXTENT), glm::max(from, to) + glm::vec3(HALF_EXTENT), [&](CubeHandle other) {
+                if (other == self)
+                    return;
+                uint32_t j = world.indexOf(other);
+                glm::vec3 offset = start - world.position(j);
+                glm::vec3 overlap = glm::vec3(2.0f * HALF_EXTENT) - glm::abs(offset);
+                if (overlap.x >= 0.0f && overlap.y >= 0.0f && overlap.z >= 0.0f)
+                    return;
+                glm::vec3 otherVelocity = bodyStamp[j] == stamp ? bodyVelocity(bodyOf[j]) : world.velocity(j);
+                glm::vec3 relative = move - otherVelocity * dTime;
+                // Slab test of the center's path against the other box grown by this box's size.
+                float enter = 0.0f, exit = toi;
+                for (int axis = 0; axis < 3; axis++) {
+                    if (relative[axis] == 0.0f) {
+                        if (std::abs(offset[axis]) >= 2.0f * HALF_EXTENT)
+                            return;
+                        continue;
+                    }
+                    float t1 = (-2.0f * HALF_EXTENT - offset[axis]) / relative[axis];
+                    float t2 = (2.0f * HALF_EXTENT - offset[axis]) / relative[axis];
+                    enter = std::max(enter, std::min(t1, t2));
+                    exit = std::min(exit, std::max(t1, t2));
+                }
+                if (enter < exit)
+                    toi = enter;
+            });
+        }
+        return toi;
+    }
+
+    void solvePosition(const Contact& c) {
+        float invA = inverseMass(c.a), invB = inverseMass(c.b);
+        float depth = penetration(c) - SLOP;
+        if (depth <= 0.0f || invA + invB == 0.0f)
+            return;
+        float push = depth * POSITION_CORRECTION / (invA + invB) * c.sign;
+        std::vector<float>* pos[3] = { &bodyX, &bodyY, &bodyZ };
+        (*pos[c.axis])[c.a] += push * invA;
+        if (invB > 0.0f)
+            (*pos[c.axis])[c.b] -= push * invB;
+    }
+
+public:
+    static constexpr float HALF_EXTENT = 0.5f;
+    // Impulse passes per step, more makes stacks stiffer. Fewer leave tall piles jittering too much to ever fall asleep.
+    static const int VELOCITY_ITERATIONS = 16;
+    static const int POSITION_ITERATIONS = 3;
+    // Penetration that is left alone, so resting cubes stay touching and keep their contact from step to step.
+    static constexpr float SLOP = 0.005f;
+    // Fraction of the penetration beyond SLOP pushed out per pass.
+    static constexpr float POSITION_CORRECTION = 0.4f;
+    static constexpr float RESTITUTION = 0.3f;
+    // Slower impacts don't bounce at all, otherwise resting cubes would jitter.
+    static constexpr float BOUNCE_THRESHOLD = 2.0f;
+    static constexpr float FRICTION = 0.6f;
+    // Cubes moving further than this in one step are swept for collisions, slower ones can't get past the middle of another cube
+    // between two steps, so the contacts alone catch them.
+    static constexpr float SWEEP_DISTANCE = HALF_EXTENT;
+    static const int MAX_SWEEP_PIECES = 16;
+    // How far a swept cube is moved into what it hit, so the contact exists next step despite rounding.
+    static constexpr float SWEEP_SKIN = 0.5f * SLOP;
+    // An island falls asleep once all of its cubes were slower than SLEEP_SPEED for SLEEP_TIME seconds.
+    static constexpr float SLEEP_SPEED = 0.3f;
+    static constexpr float SLEEP_TIME = 0.5f;
+
+    // Awake cubes integrated per job.
+    static const uint32_t JOB_GRAIN = 4096;
+
+    // Statistics of the last step() call.
+    unsigned int contactCount{};
+    unsigned int awakeCount{};
+    unsigned int sleptCount{};
+    unsigned int sweptCount{};
+
+    CubeSolver(JobSystem* jobs = nullptr) : jobs(jobs) {}
+
+    // Wakes the island the cube sleeps in and adds its cubes to moving. Does nothing for awake or unmovable cubes.
+    void wake(CubeWorld& world, CubeActiveList& moving, CubeHandle cube) {
+        growPerSlot(world);
+        CubeHandle h = cube;
+        do {
+            CubeHandle next = islandNext[h.slot];
+            islandNext[h.slot] = CubeHandle();
+            uint32_t i = world.indexOf(h);
+            if (world.hasFlag(i, CUBE_MOVABLE) && !world.hasFlag(i, CUBE_MOVING)) {
+                world.setFlag(i, CUBE_MOVING, true);
+                sleepTimer[h.slot] = 0.0f;
+                moving.insert(h);
+            }
+            // A despawned member ends the walk early, the rest of its island stays asleep until something touches it.
+            h = next;
+        } while (h && h != cube && world.alive(h));
+    }
+
+    // Wakes the cube's island and the islands of everything touching it, for cubes moved from outside the simulation (held by the player).
+    void wakeTouching(CubeWorld& world, const CubeGrid& grid, CubeActiveList& moving, CubeHandle cube) {
+        wake(world, moving, cube);
+        toWake.clear();
+        forEachTouching(grid, cube, world.position(cube), [&](CubeHandle other) { toWake.push_back(other); });
+        for (CubeHandle other : toWake)
+            wake(world, moving, other);
+    }
+
+    void step(CubeWorld& world, const CubeGrid& grid, CubeActiveList& moving, float dTime) {
+        growPerSlot(world);
+
+        // Sleeping cubes touched by awake ones join the simulation from this step on.
+        toWake.clear();
+        for (CubeHandle h : moving) {
+            forEachTouching(grid, h, world.position(h), [&](CubeHandle other) {
+                uint32_t j = world.indexOf(other);
+                if (world.hasFlag(j, CUBE_MOVABLE) && !world.hasFlag(j, CUBE_MOVING))
+                    toWake.push_back(other);
+            });
+        }
+        for (CubeHandle other : toWake)
+            wake(world, moving, other);
+
+        bodies.clear();
+        bodyX.clear(); bodyY.clear(); bodyZ.clear();
+        bodyVX.clear(); bodyVY.clear(); bodyVZ.clear();
+        bodyInvMass.clear();
+        contacts.clear();
+        bodyOf.resize(world.size());
+        bodyStamp.resize(world.size(), 0);
+        if (++stamp == 0) {
+            std::fill(bodyStamp.begin(), bodyStamp.end(), 0);
+            stamp = 1;
+        }
+        for (CubeHandle h : moving)
+            addBody(world, world.indexOf(h), 1.0f);
+        uint32_t n = (uint32_t)bodies.size();
+
+        // Contacts from where the cubes ended up last step, with every cube the grid finds touching an awake one.
+        // Pairs of two awake cubes are only added from the one with the lower slot.
+        for (uint32_t a = 0; a < n; a++) {
+            CubeHandle h = moving[a];
+            if (bodyY[a] <= HALF_EXTENT)
+                addContact(a, GROUND, 1, 1.0f);
+            forEachTouching(grid, h, bodyPosition(a), [&](CubeHandle other) {
+                uint32_t j = world.indexOf(other);
+                if (world.hasFlag(j, CUBE_MOVING) && other.slot < h.slot)
+                    return;
+                glm::vec3 d = bodyPosition(a) - world.position(j);
+                glm::vec3 overlap = glm::vec3(2.0f * HALF_EXTENT) - glm::abs(d);
+                if (overlap.x < 0.0f || overlap.y < 0.0f || overlap.z < 0.0f)
+                    return;
+                int axis = overlap.x < overlap.y ? (overlap.x < overlap.z ? 0 : 2) : (overlap.y < overlap.z ? 1 : 2);
+                addContact(a, addBody(world, j, 0.0f), axis, d[axis] >= 0.0f ? 1.0f : -1.0f);
+            });
+        }
+
+        parallelFor(jobs, n, JOB_GRAIN, [&](uint32_t begin, uint32_t end) {
+            accelerateCubes(&bodyVY[begin], (int)(end - begin), dTime * CUBE_GRAVITY);
+        });
+
+        for (int iteration = 0; iteration < VELOCITY_ITERATIONS; iteration++) {
+            for (Contact& c : contacts)
+                solveVelocity(c);
+        }
+
+        // Fast cubes would skip through thin stacks or past the ground within one step. Those few are swept along their path and
+        // stopped where they first hit something, the contact takes it from there next step. Everything else is integrated as usual.
+        impacts.clear();
+        sweptCount = 0;
+        for (uint32_t k = 0; k < n; k++) {
+            glm::vec3 v = bodyVelocity(k);
+            if (glm::dot(v, v) * dTime * dTime <= SWEEP_DISTANCE * SWEEP_DISTANCE)
+                continue;
+            sweptCount++;
+            float toi = timeOfImpact(world, grid, k, dTime);
+            if (toi < 1.0f)
+                impacts.push_back(Impact{ k, std::min(toi + SWEEP_SKIN / (glm::length(v) * dTime), 1.0f) });
+        }
+
+        parallelFor(jobs, n, JOB_GRAIN, [&](uint32_t begin, uint32_t end) {
+            moveCubes(&bodyX[begin], &bodyY[begin], &bodyZ[begin], &bodyVX[begin], &bodyVY[begin], &bodyVZ[begin], (int)(end - begin), dTime);
+        });
+
+        for (const Impact& impact : impacts) {
+            glm::vec3 back = bodyVelocity(impact.body) * (dTime * (1.0f - impact.time));
+            bodyX[impact.body] -= back.x;
+            bodyY[impact.body] -= back.y;
+            bodyZ[impact.body] -= back.z;
+        }
+
+        for (int iteration = 0; iteration < POSITION_ITERATIONS; iteration++) {
+            for (const Contact& c : contacts)
+                solvePosition(c);
+        }
+
+        // Sleep timers need how far each cube got this step, so they are updated before the results go back into the world.
+        // Speed from the distance instead of the velocity: in tall stacks the impulses don't fully converge and the leftover
+        // velocity is undone by the position correction, so the velocity alone would keep resting stacks awake forever.
+        parallelFor(jobs, n, JOB_GRAIN, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t k = begin; k < end; k++) {
+                uint32_t i = bodies[k];
+                glm::vec3 moved = (bodyPosition(k) - world.position(i)) / dTime;
+                uint32_t slot = moving[k].slot;
+                sleepTimer[slot] = glm::dot(moved, moved) < SLEEP_SPEED * SLEEP_SPEED ? sleepTimer[slot] + dTime : 0.0f;
+                world.prevX[i] = world.posX[i];
+                world.prevY[i] = world.posY[i];
+                world.prevZ[i] = world.posZ[i];
+                world.posX[i] = bodyX[k];
+                world.posY[i] = bodyY[k];
+                world.posZ[i] = bodyZ[k];
+                world.velX[i] = bodyVX[k];
+                world.velY[i] = bodyVY[k];
+                world.velZ[i] = bodyVZ[k];
+            }
+        });
+
+        // Islands: awake cubes connected by contacts. Sleeping, held and unmovable cubes don't connect anything, like the ground.
+        islandParent.resize(n);
+        islandTimer.resize(n);
+        islandHead.resize(n);
+        for (uint32_t k = 0; k < n; k++) {
+            islandParent[k] = k;
+            islandTimer[k] = SLEEP_TIME;
+            islandHead[k] = GROUND;
+        }
+        for (const Contact& c : contacts) {
+            if (c.b >= n)
+                continue;
+            uint32_t ra = findIsland(c.a), rb = findIsland(c.b);
+            if (ra != rb)
+                islandParent[ra] = rb;
+        }
+        for (uint32_t k = 0; k < n; k++) {
+            uint32_t root = findIsland(k);
+            islandTimer[root] = std::min(islandTimer[root], sleepTimer[moving[k].slot]);
+        }
+
+        // Every cube of a calm island goes to sleep, linked into a ring so touching any of them later wakes all of them.
+        sleptCount = 0;
+        for (uint32_t k = 0; k < n; k++) {
+            uint32_t root = findIsland(k);
+            if (islandTimer[root] < SLEEP_TIME)
+                continue;
+            uint32_t i = bodies[k];
+            CubeHandle h = world.handleOf(i);
+            if (islandHead[root] == GROUND) {
+                islandHead[root] = k;
+                islandNext[h.slot] = h;
+            }
+            else {
+                CubeHandle head = world.handleOf(bodies[islandHead[root]]);
+                islandNext[h.slot] = islandNext[head.slot];
+                islandNext[head.slot] = h;
+            }
+            sleepTimer[h.slot] = 0.0f;
+            world.settle(i);
+            sleptCount++;
+        }
+        contactCount = (unsigned int)contacts.size();
+        awakeCount = (unsigned int)n;
+    }
+};
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef CUBE_WORLD_H
+#define CUBE_WORLD_H
+
+#include "glm/glm.hpp"
+#include <vector>
+#include <cstdint>
+
+// Refers to one cube of a CubeWorld. Stays valid while the cube exists, even though despawning other cubes moves its data around.
+// Once the cube is despawned the generation no longer matches and CubeWorld::alive() returns false.
+struct CubeHandle {
+    static constexpr uint32_t INVALID = 0xFFFFFFFFu;
+
+    uint32_t slot = INVALID;
+    uint32_t generation = 0;
+
+    // False for the default constructed "no cube" handle.
+    explicit operator bool() const {
+        return slot != INVALID;
+    }
+    bool operator==(const CubeHandle& o) const {
+        return slot == o.slot && generation == o.generation;
+    }
+    bool operator!=(const CubeHandle& o) const {
+        return !(*this == o);
+    }
+    bool operator<(const CubeHandle& o) const {
+        return slot != o.slot ? slot < o.slot : generation < o.generation;
+    }
+};
+
+/* A set of cubes that iterates like a plain array. Insert, erase and lookup are O(1) through a position per handle slot, erase moves
+*  the last entry into the hole, so the order isn't stable and a loop that erases while iterating must not advance past the erased index.
+*/
+class CubeActiveList
+{
+private:
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
+
+    std::vector<CubeHandle> handles;
+    std::vector<uint32_t> position;
+
+public:
+    bool contains(CubeHandle h) const {
+        return h.slot < position.size() && position[h.slot] != NONE && handles[position[h.slot]] == h;
+    }
+
+    void insert(CubeHandle h) {
+        if (contains(h))
+            return;
+        if (h.slot >= position.size())
+            position.resize(h.slot + 1, NONE);
+        position[h.slot] = (uint32_t)handles.size();
+        handles.push_back(h);
+    }
+
+    void erase(CubeHandle h) {
+        if (!contains(h))
+            return;
+        uint32_t index = position[h.slot];
+        handles[index] = handles.back();
+        position[handles[index].slot] = index;
+        handles.pop_back();
+        position[h.slot] = NONE;
+    }
+
+    size_t size() const {
+        return handles.size();
+    }
+
+    bool empty() const {
+        return handles.empty();
+    }
+
+    CubeHandle operator[](size_t i) const {
+        return handles[i];
+    }
+
+    std::vector<CubeHandle>::const_iterator begin() const {
+        return handles.begin();
+    }
+
+    std::vector<CubeHandle>::const_iterator end() const {
+        return handles.end();
+    }
+};
+
+// Per cube state bits, stored in CubeWorld::flags.
+enum CubeFlag : uint8_t {
+    // Is the player looking at this cube? (cube colored red)
+    CUBE_TARGETED = 1 << 0,
+    CUBE_MOVING = 1 << 1,
+    CUBE_HELD = 1 << 2,
+    CUBE_MOVABLE = 1 << 3,
+};
+
+/* All cubes of the scene, stored as structure of arrays. The arrays are dense, entry i of every array belongs to the same cube and
+*  there are no holes, so anything that walks over all cubes (physics, picking, culling, filling the instance buffer) streams through
+*  memory linearly and only touches the fields it needs. Hot per-frame data (position, velocity, flags) is kept apart from cold data like names.
+*
+*  Dense indices change when a cube is despawned (the last cube is moved into the hole), so anything that needs to remember a cube
+*  across frames keeps a CubeHandle instead. spawn() and despawn() are both O(1).
+*/
+class CubeWorld
+{
+private:
+    // Handle slot -> dense index, and dense index -> handle slot.
+    std::vector<uint32_t> slotToIndex;
+    std::vector<uint32_t> slotGeneration;
+    std::vector<uint32_t> freeSlots;
+    std::vector<uint32_t> indexToSlot;
+
+public:
+    // Hot data, one entry per cube. prev is the position before the last physics step, the renderer blends between the two.
+    std::vector<float> posX, posY, posZ;
+    std::vector<float> prevX, prevY, prevZ;
+    std::vector<float> velX, velY, velZ;
+    std::vector<uint8_t> flags;
+    // Cold data.
+    std::vector<const char*> names;
+
+    size_t size() const {
+        return posX.size();
+    }
+
+    void reserve(size_t count) {
+        posX.reserve(count); posY.reserve(count); posZ.reserve(count);
+        prevX.reserve(count); prevY.reserve(count); prevZ.reserve(count);
+        velX.reserve(count); velY.reserve(count); velZ.reserve(count);
+        flags.reserve(count);
+        names.reserve(count);
+        indexToSlot.reserve(count);
+    }
+
+    CubeHandle spawn(glm::vec3 position, const char* name, bool movable) {
+        uint32_t slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else {
+            slot = (uint32_t)slotToIndex.size();
+            slotToIndex.push_back(CubeHandle::INVALID);
+            slotGeneration.push_back(0);
+        }
+
+        uint32_t index = (uint32_t)size();
+        posX.push_back(position.x); posY.push_back(position.y); posZ.push_back(position.z);
+        prevX.push_back(position.x); prevY.push_back(position.y); prevZ.push_back(position.z);
+        velX.push_back(0.0f); velY.push_back(0.0f); velZ.push_back(0.0f);
+        flags.push_back(movable ? CUBE_MOVABLE : 0);
+        names.push_back(name);
+        indexToSlot.push_back(slot);
+        slotToIndex[slot] = index;
+        return CubeHandle{ slot, slotGeneration[slot] };
+    }
+
+    // Removes the cube by moving the last cube into its place, the handle (and any copies of it) becomes dead.
+    void despawn(CubeHandle handle) {
+        if (!alive(handle))
+            return;
+        uint32_t index = slotToIndex[handle.slot];
+        uint32_t last = (uint32_t)size() - 1;
+        if (index != last) {
+            posX[index] = posX[last]; posY[index] = posY[last]; posZ[index] = posZ[last];
+            prevX[index] = prevX[last]; prevY[index] = prevY[last]; prevZ[index] = prevZ[last];
+            velX[index] = velX[last]; velY[index] = velY[last]; velZ[index] = velZ[last];
+            flags[index] = flags[last];
+            names[index] = names[last];
+            indexToSlot[index] = indexToSlot[last];
+            slotToIndex[indexToSlot[index]] = index;
+        }
+        posX.pop_back(); posY.pop_back(); posZ.pop_back();
+        prevX.pop_back(); prevY.pop_back(); prevZ.pop_back();
+        velX.pop_back(); velY.pop_back(); velZ.pop_back();
+        flags.pop_back();
+        names.pop_back();
+        indexToSlot.pop_back();
+
+        slotToIndex[handle.slot] = CubeHandle::INVALID;
+        slotGeneration[handle.slot]++;
+        freeSlots.push_back(handle.slot);
+    }
+
+    bool alive(CubeHandle handle) const {
+        return handle.slot < slotToIndex.size() && slotGeneration[handle.slot] == handle.generation && slotToIndex[handle.slot] != CubeHandle::INVALID;
+    }
+
+    // Dense index of a live cube, only valid until the next despawn().
+    uint32_t indexOf(CubeHandle handle) const {
+        return slotToIndex[handle.slot];
+    }
+
+    CubeHandle handleOf(uint32_t index) const {
+        uint32_t slot = indexToSlot[index];
+        return CubeHandle{ slot, slotGeneration[slot] };
+    }
+
+    // Number of handle slots ever handed out, handle.slot is always below this. Lets other structures keep per cube data in flat arrays.
+    size_t slotCount() const {
+        return slotToIndex.size();
+    }
+
+    // Accessors by dense index, for loops over all cubes.
+    glm::vec3 position(uint32_t i) const {
+        return glm::vec3(posX[i], posY[i], posZ[i]);
+    }
+    // Places the cube without a physics step, so there is nothing to interpolate from and the previous position is moved along.
+    void setPosition(uint32_t i, glm::vec3 p) {
+        posX[i] = prevX[i] = p.x;
+        posY[i] = prevY[i] = p.y;
+        posZ[i] = prevZ[i] = p.z;
+    }
+    // Position to draw the cube at, alpha is how far the render time is between the last two physics steps (0 = previous, 1 = current).
+    glm::vec3 interpolatedPosition(uint32_t i, float alpha) const {
+        return glm::vec3(prevX[i] + (posX[i] - prevX[i]) * alpha,
+                         prevY[i] + (posY[i] - prevY[i]) * alpha,
+                         prevZ[i] + (posZ[i] - prevZ[i]) * alpha);
+    }
+    glm::vec3 velocity(uint32_t i) const {
+        return glm::vec3(velX[i], velY[i], velZ[i]);
+    }
+    void setVelocity(uint32_t i, glm::vec3 v) {
+        velX[i] = v.x; velY[i] = v.y; velZ[i] = v.z;
+    }
+    bool hasFlag(uint32_t i, CubeFlag flag) const {
+        return (flags[i] & flag) != 0;
+    }
+    void setFlag(uint32_t i, CubeFlag flag, bool value) {
+        flags[i] = value ? (flags[i] | flag) : (flags[i] & ~flag);
+    }
+
+    // Accessors by handle, for gameplay code that deals with individual cubes.
+    glm::vec3 position(CubeHandle h) const { return position(indexOf(h)); }
+    void setPosition(CubeHandle h, glm::vec3 p) { setPosition(indexOf(h), p); }
+    glm::vec3 velocity(CubeHandle h) const { return velocity(indexOf(h)); }
+    void setVelocity(CubeHandle h, glm::vec3 v) { setVelocity(indexOf(h), v); }
+    bool hasFlag(CubeHandle h, CubeFlag flag) const { return hasFlag(indexOf(h), flag); }
+    void setFlag(CubeHandle h, CubeFlag flag, bool value) { setFlag(indexOf(h), flag, value); }
+
+    // Stops the cube where it is. Cubes at rest are no longer stepped, so the previous position has to catch up or it'd be drawn
+    // slightly behind forever.
+    void settle(uint32_t i) {
+        prevX[i] = posX[i];
+        prevY[i] = posY[i];
+        prevZ[i] = posZ[i];
+        velX[i] = velY[i] = velZ[i] = 0.0f;
+        setFlag(i, CUBE_MOVING, false);
+    }
+};
+
+#endif
@@ -0,0 +1,24 @@
+// Per-frame constants shared by all shaders, written once per frame from FrameUniforms.h. Shader.h puts this right after the
+// #version line of every shader it loads, so it only exists once and has to match FrameData there. The floats fill the padding
+// std140 puts after each vec3.
+struct Light {
+    vec3 ambient;
+    float cutOff;
+    vec3 diffuse;
+    float outerCutOff;
+    vec3 specular;
+    float constant;
+    // Direction of Spotlight
+    vec3 direction;
+    float linear;
+    float quadratic;
+};
+
+layout (std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    vec3 lightPos;
+    vec3 lightColor;
+    Light light;
+};
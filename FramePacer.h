@@ -0,0 +1,113 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+/* Keeps frames a fixed time apart and keeps track of how long they actually took.
+*
+*  With a target frame time, endFrame() waits out whatever is left of the frame: it sleeps for most of it and spins for the last
+*  SPIN_TIME, since sleeping can overshoot by a millisecond or more and that would show up as uneven frames. Deadlines are a fixed
+*  distance apart instead of counting from when the wait ended, so small overshoots don't add up. Without a target (0) nothing waits
+*  and vsync is expected to pace the frames, the pacer then only measures.
+*
+*  The last HISTORY frames are kept, both the time from one frame to the next and how much of it was spent working (everything
+*  before the wait), and printStats() reports percentiles of them.
+*/
+class FramePacer
+{
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    // How much of the wait is spun instead of slept.
+    static constexpr double SPIN_TIME = 0.002;
+    static const size_t HISTORY = 4096;
+
+    double target{};
+    Clock::time_point frameStart;
+    Clock::time_point deadline;
+    bool started{};
+
+    // Ring buffers of the last HISTORY frame times and frame costs, in seconds.
+    std::vector<float> frameTimes;
+    std::vector<float> frameCosts;
+    size_t next{};
+    size_t count{};
+
+    static double seconds(Clock::duration d) {
+        return std::chrono::duration<double>(d).count();
+    }
+
+    // p-th percentile (0 to 1) of the recorded values.
+    static float percentile(std::vector<float>& scratch, const std::vector<float>& values, size_t count, double p) {
+        if (count == 0)
+            return 0.0f;
+        scratch.assign(values.begin(), values.begin() + count);
+        size_t k = std::min(count - 1, (size_t)(p * count));
+        std::nth_element(scratch.begin(), scratch.begin() + k, scratch.end());
+        return scratch[k];
+    }
+
+public:
+    // targetFrameTime in seconds, 0 to leave pacing to vsync.
+    FramePacer(double targetFrameTime = 0.0) : target(targetFrameTime), frameTimes(HISTORY), frameCosts(HISTORY) {}
+
+    double targetFrameTime() const {
+        return target;
+    }
+
+    // Has to be called once at the end of every frame (after swapping buffers). Waits for the frame's deadline if there is a target
+    // and records the frame.
+    void endFrame() {
+        Clock::time_point now = Clock::now();
+        if (!started) {
+            started = true;
+            frameStart = now;
+            deadline = now;
+            return;
+        }
+        double cost = seconds(now - frameStart);
+
+        if (target > 0.0) {
+            deadline += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(target));
+            // More than a frame behind (a hitch, or frames simply take longer than the target), start counting from now again
+            // instead of rushing through frames to catch up.
+            if (deadline < now)
+                deadline = now;
+            Clock::duration remaining = deadline - now;
+            Clock::duration spin = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(SPIN_TIME));
+            if (remaining > spin)
+                std::this_thread::sleep_for(remaining - spin);
+            while (Clock::now() < deadline)
+                std::this_thread::yield();
+            now = Clock::now();
+        }
+
+        frameTimes[next] = (float)seconds(now - frameStart);
+        frameCosts[next] = (float)cost;
+        next = (next + 1) % HISTORY;
+        count = std::min(count + 1, HISTORY);
+        frameStart = now;
+    }
+
+    // Percentiles of the recorded frame times and costs in milliseconds.
+    void printStats() const {
+        std::vector<float> scratch;
+        std::cout << "FramePacer: " << count << " frames";
+        if (target > 0.0)
+            std::cout << ", target " << target * 1000.0 << " ms";
+        else
+            std::cout << ", vsync";
+        std::cout << ", frame time p50 " << percentile(scratch, frameTimes, count, 0.5) * 1000.0f
+            << " p90 " << percentile(scratch, frameTimes, count, 0.9) * 1000.0f
+            << " p99 " << percentile(scratch, frameTimes, count, 0.99) * 1000.0f
+            << " max " << percentile(scratch, frameTimes, count, 1.0) * 1000.0f
+            << " ms, cost p50 " << percentile(scratch, frameCosts, count, 0.5) * 1000.0f
+            << " p99 " << percentile(scratch, frameCosts, count, 0.99) * 1000.0f << " ms" << std::endl;
+    }
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glad/glad.h>
+#include "glm/glm.hpp"
+
+// Binding point of the FrameData uniform block, has to match "binding = 0" in FrameData.glsl.
+const unsigned int FRAME_UNIFORM_BINDING = 0;
+
+// Spotlight parameters. The floats are tucked into the padding std140 leaves behind every vec3,
+// which is why the member order differs from the obvious one (the Light struct in FrameData.glsl follows it).
+struct FrameLight {
+    glm::vec3 ambient;   float cutOff;
+    glm::vec3 diffuse;   float outerCutOff;
+    glm::vec3 specular;  float constant;
+    glm::vec3 direction; float linear;
+    float quadratic;     float pad[3];
+};
+
+// CPU mirror of the std140 "FrameData" uniform block in FrameData.glsl, which Shader adds to every shader. Everything here is the
+// same for all draws of a frame.
+struct FrameData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 viewPos;    float pad0;
+    glm::vec3 lightPos;   float pad1;
+    glm::vec3 lightColor; float pad2;
+    FrameLight light;
+};
+
+static_assert(sizeof(FrameLight) == 80, "FrameLight has to match the std140 layout of Light");
+static_assert(sizeof(FrameData) == 256, "FrameData has to match the std140 layout of the FrameData block");
+
+/* Owns the uniform buffer backing the FrameData block. Fill in data and call upload() once per frame, every program that declares
+*  the block reads from the same buffer, so camera and light don't have to be set on each shader separately anymore.
+*/
+class FrameUniforms
+{
+private:
+    unsigned int UBO{};
+
+public:
+    FrameData data{};
+
+    FrameUniforms() {
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    FrameUniforms(const FrameUniforms&) = delete;
+    FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+    void upload() {
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef HEADLESS_DRIVER_H
+#define HEADLESS_DRIVER_H
+
+#include "Simulation.h"
+#include "JobSystem.h"
+#include "CubeCulling.h"
+#include "CubeOcclusion.h"
+#include <chrono>
+#include <iostream>
+
+/* Runs the simulation without a window or GL context, for timing it on machines without a GPU (main.cpp --headless). The player is
+*  scripted: a 4 second loop of looking down a bit at the cubes ahead, grabbing the one in the crosshair, swinging it to the side while
+*  stepping sideways, letting go (which throws it), and stepping and turning back, so each loop picks up the next cube along the line
+*  of sight. Frames are a fixed 1/60 s apart, so every run does exactly the same work, and the report is how many of those frames the
+*  simulation gets through per second of real time.
+*
+*  The CPU side of drawing, frustum and occlusion culling, runs every frame as well with the window's projection, since that's the part
+*  of the renderer that costs time without a GPU. It's timed separately.
+*/
+
+// Fixed frame time of the script.
+const float HEADLESS_FRAME_TIME = 1.0f / 60.0f;
+const unsigned int HEADLESS_CYCLE = 240;
+// Aspect ratio of the window main.cpp opens.
+const float HEADLESS_ASPECT = 800.0f / 600.0f;
+
+// Input for frame number frame of the script, and how far the mouse moves after it.
+inline SimulationInput headlessInput(unsigned int frame, float& xoffset, float& yoffset) {
+    unsigned int t = frame % HEADLESS_CYCLE;
+    SimulationInput input;
+    input.time = frame * HEADLESS_FRAME_TIME;
+    xoffset = 0.0f;
+    yoffset = 0.0f;
+    if (t < 10) {
+        yoffset = -5.0f;
+    }
+    else if (t < 70) {
+        input.grab = true;
+        input.right = true;
+        xoffset = 6.0f;
+    }
+    else if (t < 130) {
+        input.left = true;
+        xoffset = -6.0f;
+    }
+    else if (t < 140) {
+        yoffset = 5.0f;
+    }
+    return input;
+}
+
+// Simulates frames frames of the script with extraCubes cubes dropped into the scene and prints how fast it went. Returns main's exit code.
+inline int runHeadless(unsigned int frames, unsigned int extraCubes, JobSystem* jobs) {
+    Simulation simulation(jobs);
+    simulation.spawnScene(extraCubes);
+    CubeOcclusion occlusion(256, 192, jobs);
+    std::vector<uint8_t> cullFlags;
+    std::vector<uint32_t> visibleCubes;
+    double cullSeconds = 0.0;
+    unsigned long long drawn = 0, culled = 0, occluded = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        float xoffset, yoffset;
+        SimulationInput input = headlessInput(frame, xoffset, yoffset);
+        simulation.frame(HEADLESS_FRAME_TIME, input);
+
+        // Same culling as CubeRenderer::draw.
+        auto cullStart = std::chrono::steady_clock::now();
+        glm::mat4 proj = glm::perspective(glm::radians(simulation.camera.Zoom), HEADLESS_ASPECT, 0.1f, 100.0f);
+        glm::mat4 viewProj = proj * simulation.camera.GetViewMatrix();
+        frustumCullWorld(simulation.world, CubeFrustum(viewProj), jobs, 16384, cullFlags, visibleCubes);
+        culled += simulation.world.size() - visibleCubes.size();
+        occlusion.cull(simulation.world, simulation.physicsAlpha(), viewProj, simulation.camera.Position, visibleCubes);
+        occluded += occlusion.occludedCount;
+        drawn += visibleCubes.size();
+        cullSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - cullStart).count();
+
+        // Mouse events arrive after the frame's input, like they do from glfwPollEvents.
+        simulation.look(xoffset, yoffset, input.grab, input.time + 0.5f * HEADLESS_FRAME_TIME);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Headless: " << frames << " frames, " << simulation.world.size() << " cubes, " << (jobs ? jobs->threadCount() : 1) << " threads, "
+        << seconds * 1000.0 / frames << " ms per frame, "
+        << frames / seconds << " simulated frames per second, " << simulation.movingCubes.size() << " cubes awake at the end" << std::endl;
+    if (frames > 0) {
+        std::cout << "Culling: " << cullSeconds * 1000.0 / frames << " ms per frame, on average " << drawn / frames << " cubes drawn, "
+            << culled / frames << " outside the view, " << occluded / frames << " hidden behind others" << std::endl;
+    }
+    return 0;
+}
+
+#endif
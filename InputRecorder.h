@@ -0,0 +1,218 @@
+#ifndef INPUT_RECORDER_H
+#define INPUT_RECORDER_H
+
+#include <GLFW/glfw3.h>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+
+/* Everything the game reads from GLFW goes through here: the frame time, the keys and the mouse button, and the cursor and scroll
+*  events. Normally that is just GLFW. When recording, every value handed out is also written to a log file, and when replaying the
+*  values come from such a log instead of GLFW, so a recorded session (walk up, grab a cube, throw it) plays out exactly the same way
+*  every time, which makes it usable for profiling and timing regressions.
+*
+*  The log is binary: a magic number, then one record per frame or event. Each record is a type byte, the time as a double, and
+*  depending on the type the key/button states as a bit mask, the cursor position or the scroll offset. Times and positions are stored
+*  as the doubles GLFW returned, so nothing is rounded on the way.
+*/
+class InputRecorder
+{
+public:
+    enum Mode {
+        LIVE,
+        RECORD,
+        REPLAY
+    };
+
+private:
+    enum RecordType : uint8_t {
+        FRAME,
+        CURSOR,
+        SCROLL
+    };
+
+    // "CIN1" at the start of every log.
+    static const uint32_t MAGIC = 0x314E4943u;
+
+    // The keys the game uses, bit i of the state mask is trackedKey(i), the bit after them is the left mouse button.
+    static const int KEY_COUNT = 5;
+    static const uint8_t LEFT_BUTTON_BIT = 1 << KEY_COUNT;
+
+    static int trackedKey(int i) {
+        static const int keys[KEY_COUNT] = { GLFW_KEY_ESCAPE, GLFW_KEY_W, GLFW_KEY_A, GLFW_KEY_S, GLFW_KEY_D };
+        return keys[i];
+    }
+
+    Mode mode{ LIVE };
+    std::ofstream out;
+    std::ifstream in;
+    // Time and key/button states of the current frame, or of the event being handled during pollEvents().
+    double now{};
+    uint8_t state{};
+    bool ended{};
+
+    static int keyBit(int key) {
+        for (int i = 0; i < KEY_COUNT; i++) {
+            if (trackedKey(i) == key)
+                return i;
+        }
+        return -1;
+    }
+
+    static uint8_t sampleState(GLFWwindow* window) {
+        uint8_t bits = 0;
+        for (int i = 0; i < KEY_COUNT; i++) {
+            if (glfwGetKey(window, trackedKey(i)) == GLFW_PRESS)
+                bits |= 1 << i;
+        }
+        if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+            bits |= LEFT_BUTTON_BIT;
+        return bits;
+    }
+
+    template<typename T>
+    void write(const T& value) {
+        out.write((const char*)&value, sizeof(T));
+    }
+
+    template<typename T>
+    bool read(T& value) {
+        return (bool)in.read((char*)&value, sizeof(T));
+    }
+
+public:
+    // Frames handed out by beginFrame() so far.
+    unsigned int frames{};
+
+    // Starts recording to or replaying from path. Returns false (and stays live) if the file can't be opened or isn't a log.
+    bool open(Mode newMode, const char* path) {
+        if (newMode == RECORD) {
+            out.open(path, std::ios::binary);
+            if (!out) {
+                std::cout << "Failed to open input log " << path << " for writing" << std::endl;
+                return false;
+            }
+            write((uint32_t)MAGIC);
+        }
+        else if (newMode == REPLAY) {
+            in.open(path, std::ios::binary);
+            uint32_t magic = 0;
+            if (!in || !read(magic) || magic != MAGIC) {
+                std::cout << "Failed to open input log " << path << std::endl;
+                return false;
+            }
+        }
+        mode = newMode;
+        return true;
+    }
+
+    Mode currentMode() const {
+        return mode;
+    }
+
+    // True once a replay has used up its log.
+    bool finished() const {
+        return ended;
+    }
+
+    // Starts a frame and returns its time, replaces glfwGetTime() at the top of the loop.
+    double beginFrame(GLFWwindow* window) {
+        if (mode != REPLAY) {
+            frames++;
+            now = glfwGetTime();
+            state = sampleState(window);
+            if (mode == RECORD) {
+                write((uint8_t)FRAME);
+                write(now);
+                write(state);
+            }
+            return now;
+        }
+        uint8_t type;
+        if (!ended && read(type) && type == FRAME && read(now) && read(state)) {
+            frames++;
+            return now;
+        }
+        // Out of frames, hold the last state until the caller notices finished().
+        ended = true;
+        state = 0;
+        return now;
+    }
+
+    // Time of the current frame, or of the event being handled.
+    double time() const {
+        return now;
+    }
+
+    // glfwGetKey(window, key) == GLFW_PRESS, for keys the recorder tracks.
+    bool key(GLFWwindow* window, int key) const {
+        int bit = keyBit(key);
+        if (bit < 0)
+            return mode != REPLAY && glfwGetKey(window, key) == GLFW_PRESS;
+        return (state & (1 << bit)) != 0;
+    }
+
+    // glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS.
+    bool leftButton() const {
+        return (state & LEFT_BUTTON_BIT) != 0;
+    }
+
+    // Has to be called first thing in the cursor callback. Takes the event's time and button state, and logs it when recording.
+    void cursorMoved(GLFWwindow* window, double x, double y) {
+        if (mode == REPLAY)
+            return;
+        now = glfwGetTime();
+        state = sampleState(window);
+        if (mode == RECORD) {
+            write((uint8_t)CURSOR);
+            write(now);
+            write(state);
+            write(x);
+            write(y);
+        }
+    }
+
+    // Same for the scroll callback.
+    void scrolled(double y) {
+        if (mode == REPLAY)
+            return;
+        now = glfwGetTime();
+        if (mode == RECORD) {
+            write((uint8_t)SCROLL);
+            write(now);
+            write(y);
+        }
+    }
+
+    // Replaces glfwPollEvents(). When replaying, the events logged after the current frame are handed to the callbacks in their order.
+    // GLFW is still polled so the window stays responsive, but the cursor and scroll callbacks shouldn't be registered with it then.
+    void pollEvents(GLFWwindow* window, void (*cursor)(GLFWwindow*, double, double), void (*scroll)(GLFWwindow*, double, double)) {
+        glfwPollEvents();
+        if (mode != REPLAY)
+            return;
+        while (!ended) {
+            int next = in.peek();
+            if (next == std::char_traits<char>::eof() || next == FRAME)
+                break;
+            uint8_t type;
+            double x = 0.0, y = 0.0;
+            bool ok = read(type) && read(now);
+            if (ok && type == CURSOR)
+                ok = read(state) && read(x) && read(y);
+            else if (ok && type == SCROLL)
+                ok = read(y);
+            else
+                ok = false;
+            if (!ok) {
+                ended = true;
+                break;
+            }
+            if (type == CURSOR)
+                cursor(window, x, y);
+            else
+                scroll(window, 0.0, y);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+// Counts the jobs of a batch that haven't finished yet. Whoever needs the results calls JobSystem::wait on it, which is how one
+// batch of work is made to depend on another.
+struct JobCounter {
+    std::atomic<int> pending{ 0 };
+};
+
+/* Work stealing job scheduler. Every thread (the main thread is thread 0, the rest are workers) has its own queue. New jobs go to
+*  the back of the submitting thread's queue and are taken from the back again, so a thread mostly works on what it just split up
+*  and is still in its cache. A thread that runs dry steals from the front of someone else's queue, where the oldest and usually
+*  biggest pieces of work are.
+*
+*  Nothing blocks while there is work: wait() runs queued jobs itself until the counter it waits for reaches zero, so the main thread
+*  helps out instead of idling. Jobs are plain function pointers plus a range, so submitting one doesn't allocate (the queues keep their memory).
+*/
+class JobSystem
+{
+private:
+    struct Job {
+        void (*run)(const void* data, uint32_t begin, uint32_t end);
+        const void* data;
+        uint32_t begin, end;
+        JobCounter* counter;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    // Jobs pushed but not taken yet, idle workers sleep while this is 0.
+    std::atomic<int> queued{ 0 };
+    std::mutex sleepMutex;
+    std::condition_variable workAvailable;
+    bool stopping{};
+
+    // The system the calling thread is a worker of, and its queue there.
+    struct WorkerSlot {
+        const JobSystem* system;
+        unsigned int index;
+    };
+
+    static WorkerSlot& workerSlot() {
+        thread_local WorkerSlot slot{ nullptr, 0 };
+        return slot;
+    }
+
+    // Queue of the calling thread. Threads that aren't workers of this system, including the workers of another JobSystem, share the
+    // main thread's queue.
+    unsigned int threadIndex() const {
+        const WorkerSlot& slot = workerSlot();
+        return slot.system == this ? slot.index : 0;
+    }
+
+    void push(const Job& job) {
+        Queue& queue = *queues[threadIndex()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(job);
+        }
+        queued++;
+        // Taking the lock makes sure a worker that just found nothing to do is already waiting, so it can't miss this notify.
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        workAvailable.notify_one();
+    }
+
+    bool pop(Job& job) {
+        unsigned int self = threadIndex();
+        {
+            Queue& own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.jobs.empty()) {
+                job = own.jobs.back();
+                own.jobs.pop_back();
+                queued--;
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); i++) {
+            Queue& victim = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs.empty()) {
+                job = victim.jobs.front();
+                victim.jobs.pop_front();
+                queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void execute(const Job& job) {
+        job.run(job.data, job.begin, job.end);
+        job.counter->pending--;
+    }
+
+    void workerLoop(unsigned int index) {
+        workerSlot() = WorkerSlot{ this, index };
+        for (;;) {
+            Job job;
+            if (pop(job)) {
+                execute(job);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            workAvailable.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping)
+                return;
+        }
+    }
+
+public:
+    // 0 threads means one per hardware thread, counting the main thread.
+    JobSystem(unsigned int threadCount = 0) {
+        if (threadCount == 0) {
+            unsigned int hw = std::thread::hardware_concurrency();
+            threadCount = hw > 0 ? hw : 1;
+        }
+        for (unsigned int i = 0; i < threadCount; i++)
+            queues.emplace_back(new Queue());
+        for (unsigned int i = 1; i < threadCount; i++)
+            workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        for (std::thread& t : workers)
+            t.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Threads that run jobs, including the main thread.
+    unsigned int threadCount() const {
+        return (unsigned int)queues.size();
+    }
+
+    // Queues f() as one job counted by counter. f is referenced, not copied, so it has to stay alive until wait(counter) returns.
+    template<typename F>
+    void run(JobCounter& counter, const F& f) {
+        counter.pending++;
+        push(Job{ [](const void* data, uint32_t, uint32_t) { (*(const F*)data)(); }, &f, 0, 0, &counter });
+    }
+
+    // Runs queued jobs on this thread until every job counted by counter has finished.
+    void wait(JobCounter& counter) {
+        while (counter.pending > 0) {
+            Job job;
+            if (pop(job))
+                execute(job);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    // Calls f(begin, end) for consecutive ranges of at most grain items covering [0, count), spread over all threads, and returns when
+    // all of them are done. The calling thread does the first range itself.
+    template<typename F>
+    void parallelFor(uint32_t count, uint32_t grain, const F& f) {
+        if (count <= grain || workers.empty()) {
+            if (count > 0)
+                f(0, count);
+            return;
+        }
+        JobCounter counter;
+        auto trampoline = [](const void* data, uint32_t begin, uint32_t end) { (*(const F*)data)(begin, end); };
+        for (uint32_t begin = grain; begin < count; begin += grain) {
+            counter.pending++;
+            push(Job{ trampoline, &f, begin, count - begin < grain ? count : begin + grain, &counter });
+        }
+        f(0, grain);
+        wait(counter);
+    }
+};
+
+// parallelFor for code that may or may not have a job system, without one everything runs on the calling thread.
+template<typename F>
+inline void parallelFor(JobSystem* jobs, uint32_t count, uint32_t grain, const F& f) {
+    if (jobs)
+        jobs->parallelFor(count, grain, f);
+    else if (count > 0)
+        f(0, count);
+}
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef RENDER_BENCHMARKS_H
+#define RENDER_BENCHMARKS_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "Shader.h"
+#include "CubeWorld.h"
+#include "CubeRenderer.h"
+#include "JobSystem.h"
+#include "TextureCache.h"
+#include "AsyncAssetLoader.h"
+#include "FrameUniforms.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* Benchmarks that need a GL context, main.cpp runs them with --bench <name> once the window is open instead of the game. Every frame
+*  ends with glFinish, so frame times include the GPU and don't just measure how fast commands can be queued. Vsync is turned off for them.
+*  The ones that don't touch GL are in Benchmarks.h.
+*/
+
+// Frames timed per measurement.
+const unsigned int RENDER_BENCH_FRAMES = 100;
+
+/* --bench draw: cubes cubes (100000 when 0) in a block straight ahead of the camera, far enough away that all of them are inside the
+*  frustum, drawn with CubeRenderer with occlusion culling off, so every cube ends up in the one instanced draw. For comparison the same
+*  cubes are drawn with one draw call per cube, the way they were before the renderer existed.
+*/
+inline int benchDraw(GLFWwindow* window, Shader& lightShader, unsigned int cubes) {
+    if (cubes == 0)
+        cubes = 100000;
+    glfwSwapInterval(0);
+    JobSystem jobs;
+    TextureCache textures;
+    CubeRenderer renderer(textures, &jobs);
+    renderer.occlusionCulling = false;
+
+    CubeWorld world;
+    world.reserve(cubes);
+    unsigned int side = (unsigned int)std::ceil(std::cbrt((float)cubes));
+    for (unsigned int i = 0; i < cubes; i++) {
+        glm::vec3 position(((float)(i % side) - side * 0.5f) * 1.05f, ((float)(i / side % side) - side * 0.5f) * 1.05f,
+            -2.0f * side - (float)(i / (side * side)) * 1.05f);
+        world.spawn(position, "cube", false);
+    }
+
+    // The block is side * 1.05 wide and starts 2 * side away, well within the 45 degree field of view.
+    glm::vec3 viewPos(0.0f), viewDir(0.0f, 0.0f, -1.0f);
+    glm::mat4 view = glm::lookAt(viewPos, viewPos + viewDir, glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 4.0f * side);
+
+    FrameUniforms frameUniforms;
+    frameUniforms.data.view = view;
+    frameUniforms.data.projection = proj;
+    frameUniforms.data.viewPos = viewPos;
+    frameUniforms.data.lightColor = glm::vec3(1.0f);
+    frameUniforms.data.light.ambient = glm::vec3(0.1f);
+    frameUniforms.data.light.diffuse = glm::vec3(0.8f);
+    frameUniforms.data.light.constant = 1.0f;
+    frameUniforms.data.light.direction = viewDir;
+    frameUniforms.data.light.cutOff = glm::cos(glm::radians(12.5f));
+    frameUniforms.data.light.outerCutOff = glm::cos(glm::radians(25.0f));
+    frameUniforms.upload();
+
+    lightShader.use();
+    lightShader.setInt("material.diffuse", 0);
+    lightShader.setInt("material.specular", 1);
+    lightShader.setInt("material.emission", 2);
+    double drawSeconds = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int frame = 0; frame < RENDER_BENCH_FRAMES; frame++) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        auto drawStart = std::chrono::steady_clock::now();
+        renderer.draw(world, 1.0f, viewPos, viewDir, proj * view);
+        drawSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - drawStart).count();
+        glfwSwapBuffers(window);
+        glFinish();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Bench draw: " << cubes << " cubes, " << renderer.drawCalls << " draw call for " << renderer.instanceCount << " instances ("
+        << renderer.culledCount << " culled), " << seconds * 1000.0 / RENDER_BENCH_FRAMES << " ms per frame, " << drawSeconds * 1000.0 / RENDER_BENCH_FRAMES
+        << " ms of it in CubeRenderer::draw" << std::endl;
+
+    // One draw call per cube, the old way. The instance buffer still holds all cubes from the last draw, so each call draws one instance
+    // of it with the same shader and textures and only the number of calls differs.
+    start = std::chrono::steady_clock::now();
+    for (unsigned int frame = 0; frame < RENDER_BENCH_FRAMES; frame++) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        for (unsigned int i = 0; i < cubes; i++)
+            glDrawElementsInstancedBaseInstance(GL_TRIANGLES, CUBE_INDEX_COUNT, GL_UNSIGNED_SHORT, (void*)0, 1, i);
+        glfwSwapBuffers(window);
+        glFinish();
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Bench draw: " << cubes << " cubes, " << world.size() << " draw calls, " << seconds * 1000.0 / RENDER_BENCH_FRAMES
+        << " ms per frame" << std::endl;
+    return 0;
+}
+
+/* --bench cache: acquires diamond.jpg count times (10000 when 0), the way that many cubes each loading their own material used to, and
+*  once more with clamped sampling, through an AsyncAssetLoader like the game does. Fails unless the image was decoded once per sampler
+*  setting and every other acquire was a hit, and unless releasing all of them leaves no texture behind.
+*/
+inline int benchTextureCache(unsigned int count) {
+    if (count == 0)
+        count = 10000;
+    AsyncAssetLoader loader;
+    TextureCache cache(&loader);
+    std::vector<unsigned int> acquired;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < count; i++)
+        acquired.push_back(cache.acquire("diamond.jpg"));
+    SamplerSettings clamped;
+    clamped.wrapS = clamped.wrapT = GL_CLAMP_TO_EDGE;
+    acquired.push_back(cache.acquire("diamond.jpg", clamped));
+    while (cache.pending > 0)
+        cache.update();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    cache.printStats();
+
+    bool shared = acquired.back() != acquired[0];
+    for (unsigned int i = 0; i < count; i++)
+        shared = shared && acquired[i] == acquired[0];
+    bool deduplicated = shared && cache.misses == 2 && cache.hits == count - 1 && cache.size() == 2;
+    for (unsigned int texture : acquired)
+        cache.release(texture);
+    bool freed = cache.size() == 0 && cache.residentBytes == 0;
+    std::cout << "Bench cache: " << count + 1 << " acquires, " << cache.misses << " decodes, " << seconds * 1000.0 << " ms" << std::endl;
+    if (!deduplicated || !freed) {
+        std::cout << "Bench cache: " << (deduplicated ? "textures were left over after releasing all of them" : "the same image was decoded more than once")
+            << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/* --bench uniforms: sets the plain shader's model matrix count times (1000000 when 0) in three ways: by name with a
+*  glGetUniformLocation for every set, like Shader did before it cached locations, by name through the cached table, and through a
+*  Uniform handle. Only the sets are timed, nothing is drawn.
+*/
+inline int benchUniforms(Shader& plainShader, unsigned int count) {
+    if (count == 0)
+        count = 1000000;
+    plainShader.use();
+    glm::mat4 model(1.0f);
+    auto timeSets = [&](const char* label, auto set) {
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < count; i++) {
+            model[3][0] = (float)i;
+            set();
+        }
+        glFinish();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Bench uniforms: " << label << ", " << count << " sets, " << seconds * 1e9 / count << " ns per set" << std::endl;
+    };
+
+    timeSets("glGetUniformLocation every set", [&] {
+        std::string name = "model";
+        glUniformMatrix4fv(glGetUniformLocation(plainShader.ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(model));
+    });
+    timeSets("by name from the cached table", [&] { plainShader.setMatrix4fv("model", model); });
+    const Uniform handle = plainShader.uniform("model");
+    timeSets("Uniform handle", [&] { plainShader.setMatrix4fv(handle, model); });
+    return 0;
+}
+
+// Runs the GL benchmark called name, see above. Returns main's exit code.
+inline int runRenderBenchmark(const std::string& name, GLFWwindow* window, Shader& lightShader, Shader& plainShader, unsigned int cubes) {
+    if (name == "draw")
+        return benchDraw(window, lightShader, cubes);
+    if (name == "cache")
+        return benchTextureCache(cubes);
+    if (name == "uniforms")
+        return benchUniforms(plainShader, cubes);
+    std::cout << "Unknown benchmark " << name << std::endl;
+    return -1;
+}
+
+#endif
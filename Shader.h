@@ -8,11 +8,63 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
 #include "glm/glm.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
+// handle to a uniform, looked up once after linking so setting it needs neither a string nor a driver call. -1 if the program has no such uniform.
+struct Uniform
+{
+    int location = -1;
+};
+
 class Shader
 {
+private:
+    // every active uniform of the linked program, filled once by introspection in the constructor
+    struct UniformEntry
+    {
+        std::string name;
+        int location;
+    };
+    std::vector<UniformEntry> uniforms;
+
+    // shared declarations every shader gets (the FrameData uniform block), kept in one file instead of pasted into each shader
+    static constexpr const char* FRAME_DATA_PATH = "FrameData.glsl";
+
+    // puts include right after the #version line of code, which has to stay the first line. The #line after it keeps compile errors
+    // pointing at the shader file's own line numbers.
+    static std::string insertAfterVersion(const std::string& code, const std::string& include)
+    {
+        size_t lineEnd = code.find('\n');
+        if (code.compare(0, 8, "#version") != 0 || lineEnd == std::string::npos)
+            return code;
+        return code.substr(0, lineEnd + 1) + include + "\n#line 2\n" + code.substr(lineEnd + 1);
+    }
+
+    void queryUniforms()
+    {
+        int count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<char> nameBuffer(maxLength > 0 ? maxLength : 1);
+        for (int i = 0; i < count; i++)
+        {
+            int length = 0, size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+            std::string name(nameBuffer.data(), length);
+            int location = glGetUniformLocation(ID, name.c_str());
+            // members of uniform blocks don't have a location, they're set through their buffer
+            if (location < 0)
+                continue;
+            // arrays are reported as "name[0]", make them reachable by their plain name as well
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+                uniforms.push_back({ name.substr(0, name.size() - 3), location });
+            uniforms.push_back({ name, location });
+        }
+    }
+
 public:
     // the program ID
     unsigned int ID;
@@ -25,29 +77,38 @@ public:
         std::string fragmentCode;
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
+        std::ifstream frameDataFile;
+        std::string frameDataCode;
         // ensure ifstream objects can throw exceptions:
         vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
         fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        frameDataFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
         try
         {
             // open files
             vShaderFile.open(vertexPath);
             fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
+            frameDataFile.open(FRAME_DATA_PATH);
+            std::stringstream vShaderStream, fShaderStream, frameDataStream;
             // read file's buffer contents into streams
             vShaderStream << vShaderFile.rdbuf();
             fShaderStream << fShaderFile.rdbuf();
+            frameDataStream << frameDataFile.rdbuf();
             // close file handlers
             vShaderFile.close();
             fShaderFile.close();
+            frameDataFile.close();
             // convert stream into string
             vertexCode = vShaderStream.str();
             fragmentCode = fShaderStream.str();
+            frameDataCode = frameDataStream.str();
         }
         catch (std::ifstream::failure e)
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
+        vertexCode = insertAfterVersion(vertexCode, frameDataCode);
+        fragmentCode = insertAfterVersion(fragmentCode, frameDataCode);
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
 
@@ -97,6 +158,8 @@ public:
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
+
+        queryUniforms();
     }
 
     // use/activate the shader
@@ -104,26 +167,58 @@ public:
     {
         glUseProgram(ID);
     }
-    // utility uniform functions
+    // looks up a uniform handle, do this once at setup and keep the handle around instead of setting uniforms by name every frame
+    Uniform uniform(const std::string& name) const
+    {
+        for (const UniformEntry& u : uniforms)
+        {
+            if (u.name == name)
+                return Uniform{ u.location };
+        }
+        return Uniform{};
+    }
+    // utility uniform functions, by handle
+    void setBool(Uniform u, bool value) const
+    {
+        glUniform1i(u.location, (int)value);
+    }
+    void setInt(Uniform u, int value) const
+    {
+        glUniform1i(u.location, value);
+    }
+    void setFloat(Uniform u, float value) const
+    {
+        glUniform1f(u.location, value);
+    }
+    void setMatrix4fv(Uniform u, const glm::mat4& value) const
+    {
+        glUniformMatrix4fv(u.location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+    void setVec3(Uniform u, const glm::vec3& value) const
+    {
+        glUniform3fv(u.location, 1, glm::value_ptr(value));
+    }
+    // utility uniform functions, by name. These go through the introspection table instead of asking the driver,
+    // but still compare strings, so prefer handles for anything that runs every frame.
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        setBool(uniform(name), value);
     }
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        setInt(uniform(name), value);
     }
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        setFloat(uniform(name), value);
     }
     void setMatrix4fv(const std::string& name, glm::mat4 value) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+        setMatrix4fv(uniform(name), value);
     }
     void setVec3(const std::string& name, glm::vec3 value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+        setVec3(uniform(name), value);
     }
 };
 
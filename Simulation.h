@@ -0,0 +1,305 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "Camera.h"
+#include "CubeWorld.h"
+#include "CubeBVH.h"
+#include "CubeGrid.h"
+#include "CubeSolver.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+
+// What the player does during one frame. Filled from the keyboard and mouse (or a recording of them), or from a script when headless.
+struct SimulationInput {
+    bool forward{}, backward{}, left{}, right{};
+    // Left mouse button, holds the targeted cube.
+    bool grab{};
+    // Time of the frame in seconds, the throw velocity depends on how long ago the mouse last moved.
+    float time{};
+};
+
+/* Everything the game does apart from drawing: the cubes and their physics, the camera, targeting the cube in the crosshair and
+*  grabbing and throwing it. Nothing in here touches GLFW or OpenGL, so it runs the same with a window (main.cpp feeds it the input
+*  and draws the result) as without one (HeadlessDriver.h feeds it scripted input, on machines that don't even have a GPU).
+*/
+class Simulation
+{
+public:
+    // Physics runs at a fixed rate no matter how fast frames are drawn, so thrown cubes fly the same way at 30 or 300 fps.
+    static constexpr float PHYSICS_RATE = 120.0f;
+    static constexpr float PHYSICS_STEP = 1.0f / PHYSICS_RATE;
+    // Longest stretch of time simulated in one frame. After a hitch (window dragged, breakpoint) the simulation slows down instead of
+    // running so many steps that the next frame takes even longer.
+    static constexpr float MAX_FRAME_TIME = 0.25f;
+
+    // All cubes of the scene.
+    CubeWorld world;
+    Camera camera;
+    CubeHandle lightCube;
+
+    // Cubes the physics currently moves.
+    CubeActiveList movingCubes;
+    // Picking structure over all cubes, moved cubes refit it every frame.
+    CubeBVH bvh;
+    // Cubes by the grid cell they're in, kept up to date the same way. The solver finds the cubes touching each awake one with it,
+    // and fast cubes sweep their way through it.
+    CubeGrid grid;
+    CubeSolver solver;
+
+    // Cube that the camera is currently looking at (empty handle if no cube is looked at)
+    CubeHandle targetedCube;
+    // Information about the previously held cube and its direction.
+    CubeHandle prevTargetedCube;
+    bool prevHeld = false;
+    glm::vec3 prevFront = glm::vec3(0.0f);
+
+    float deltaTime = 0.0f; // Time between current frame and last frame.
+    float lastMouseMov = 0.0f; // Timing of how long the last mouse rotation was.
+    // Simulated time that hasn't been stepped yet, always less than one PHYSICS_STEP after frame().
+    float physicsAccumulator = 0.0f;
+
+    Simulation(JobSystem* jobs = nullptr) : camera(glm::vec3(0.0f, 1.5f, 4.0f)), solver(jobs) {}
+
+    /* Spawns the scene: 9 cubes in a 3x3 grid, the light, and extraCubes more dropped in layers behind the grid, where they fall
+    *  into a pile and go to sleep. Builds the spatial structures afterwards.
+    */
+    void spawnScene(unsigned int extraCubes = 0) {
+        const char* gridNames[] = { "cube0", "cube1", "cube2", "cube3", "cube4", "cube5", "cube6", "cube7", "cube8" };
+        const glm::vec3 gridPositions[] = {
+            glm::vec3(0.0f, 0.5f, 0.0f), glm::vec3(1.5f, 0.5f, 1.5f), glm::vec3(1.5f, 0.5f, 0.0f),
+            glm::vec3(1.5f, 0.5f, -1.5f), glm::vec3(0.0f, 0.5f, -1.5f), glm::vec3(-1.5f, 0.5f, -1.5f),
+            glm::vec3(-1.5f, 0.5f, 0.0f), glm::vec3(-1.5f, 0.5f, 1.5f), glm::vec3(0.0f, 0.5f, 1.5f)
+        };
+        world.reserve(world.size() + 10 + extraCubes);
+        for (int i = 0; i < 9; i++) {
+            world.spawn(gridPositions[i], gridNames[i], true);
+        }
+        lightCube = world.spawn(glm::vec3(0.0f, 4.0f, 1.5f), "lightCube", false);
+
+        unsigned int side = (unsigned int)std::ceil(std::sqrt((float)extraCubes / 4.0f));
+        for (unsigned int i = 0; i < extraCubes; i++) {
+            unsigned int layer = i / (side * side), row = i / side % side, column = i % side;
+            glm::vec3 position(((float)column - side * 0.5f) * 1.05f, 0.5f + layer * 1.1f, -4.0f - row * 1.05f);
+            CubeHandle cube = world.spawn(position, "cube", true);
+            world.setFlag(cube, CUBE_MOVING, true);
+            movingCubes.insert(cube);
+        }
+
+        bvh.build(world);
+        grid.build(world);
+    }
+
+    // One frame: picks the targeted cube, applies the player's input and runs as many physics steps as fit into dt.
+    void frame(float dt, const SimulationInput& input) {
+        deltaTime = dt;
+
+        // The held cube was moved by look() and processInput since the last refit.
+        // Anything it touches (or that was resting on it) wakes up, so the held cube can push sleeping cubes around.
+        if (prevHeld && targetedCube) {
+            bvh.update(world, targetedCube);
+            grid.update(world, targetedCube);
+            solver.wakeTouching(world, grid, movingCubes, targetedCube);
+        }
+
+        // Only the closest cube along the line of sight is targeted, the BVH query already returns just that one.
+        // Targeted flag also determins cube color, so the previous one needs to be reset so that cubes aren't all painted red over time.
+        CubeBVH::Hit hit = bvh.raycast(camera.Position, camera.Front);
+        if (targetedCube) {
+            world.setFlag(targetedCube, CUBE_TARGETED, false);
+        }
+        if (hit.cube) {
+            world.setFlag(hit.cube, CUBE_TARGETED, true);
+            prevTargetedCube = targetedCube;
+            targetedCube = hit.cube;
+        }
+        else {
+            targetedCube = CubeHandle();
+        }
+        if (!prevHeld) {
+            prevTargetedCube = CubeHandle();
+        }
+
+        processInput(input);
+
+        // Step the awake cubes as many fixed steps as fit into the time that passed. The solver adds cubes it wakes up to movingCubes,
+        // and clears the moving flag of cubes that fell asleep, so they wont be processed in the next step.
+        physicsAccumulator += std::min(deltaTime, MAX_FRAME_TIME);
+        while (physicsAccumulator >= PHYSICS_STEP) {
+            solver.step(world, grid, movingCubes, PHYSICS_STEP);
+            // Erasing moves the last cube into the hole, so the index only advances past cubes that stay.
+            for (size_t k = 0; k < movingCubes.size(); ) {
+                CubeHandle c = movingCubes[k];
+                bvh.update(world, c);
+                grid.update(world, c);
+                if (!world.hasFlag(c, CUBE_MOVING)) {
+                    movingCubes.erase(c);
+                }
+                else {
+                    k++;
+                }
+            }
+            physicsAccumulator -= PHYSICS_STEP;
+        }
+    }
+
+    // How far between the last two physics steps the current frame is, cubes are drawn blended between the two.
+    float physicsAlpha() const {
+        return physicsAccumulator / PHYSICS_STEP;
+    }
+
+    // The mouse moved by the given offsets (already relative to the last position), turns the camera and swings a held cube along.
+    void look(float xoffset, float yoffset, bool grab, float time) {
+        // Save previous orientation so that we can calculate the change in direction to the previus frame.
+        float prevYaw = camera.Yaw;
+        float prevPitch = camera.Pitch;
+        prevFront = camera.Front;
+        // Pass on the mouse movement offsets which are then translated into camera rotations.
+        camera.ProcessMouseMovement(xoffset, yoffset);
+        // Saves the time when the last mouse movment ended, so that I can calculate a time span how long the most
+        // recent mouse movement lasted, by which I can scale the angular velocity.
+        lastMouseMov = time;
+
+        if (grab) {
+            if (targetedCube) {
+                // Acquire vector pointing from camera to targeted cube
+                glm::vec3 cameraToCube = world.position(targetedCube) - camera.Position;
+
+                float dYaw = camera.Yaw - prevYaw;
+                float dPitch = camera.Pitch - prevPitch;
+
+                // Rotate cameraToCube vector by change in player direction.
+                // dYaw is negated because a camera rotation the right results in a positive dYaw
+                // but a positive dYaw means a rotation to the left. Rotating the camera downards
+                // makes dPitch positive, and positive dPatch also corresponds to a downwards rotation.
+                glm::mat4 RAroundY = glm::rotate(glm::mat4(1.0f), -glm::radians(dYaw), glm::vec3(0, 1, 0));
+                glm::mat4 RAroundRight = glm::rotate(glm::mat4(1.0f), glm::radians(dPitch), camera.Right);
+                glm::mat4 R = RAroundRight * RAroundY;
+                glm::vec3 rotated = glm::mat3(R) * cameraToCube;
+
+                world.setPosition(targetedCube, camera.Position + rotated);
+            }
+        }
+    }
+
+    // Scrolling changes the FOV.
+    void zoom(float yoffset) {
+        camera.ProcessMouseScroll(yoffset);
+    }
+
+private:
+    // A, W, S, and D and are used to steer the camera Left, Forward, Backwards and Right.
+    void processInput(const SimulationInput& input) {
+        glm::vec3 previousPos = camera.Position;
+        if (input.forward)
+            camera.ProcessKeyboard(FORWARD, deltaTime);
+        if (input.backward)
+            camera.ProcessKeyboard(BACKWARD, deltaTime);
+        if (input.left)
+            camera.ProcessKeyboard(LEFT, deltaTime);
+        if (input.right)
+            camera.ProcessKeyboard(RIGHT, deltaTime);
+
+        /* If the mouse button is held the cube is displayed by the same movement as the camera.
+        *  When the mouse button is no longer held the previously held cube will retrain the movement of the player or camer rotation.
+        *  When a cube is moving it is inserted into the movingCubes list, where its movement will be processed every frame until it hits
+        *  the ground. */
+        if (input.grab) {
+            if (prevHeld && prevTargetedCube && prevTargetedCube != targetedCube) {
+                if (world.hasFlag(prevTargetedCube, CUBE_MOVABLE)) {
+                    world.setFlag(prevTargetedCube, CUBE_MOVING, true);
+                    world.setVelocity(prevTargetedCube, world.velocity(prevTargetedCube) + calculateAngularVelocity(prevFront, camera.Front, input.time - lastMouseMov));
+                    movingCubes.insert(prevTargetedCube);
+                }
+            }
+            if (targetedCube) {
+                world.setFlag(targetedCube, CUBE_MOVING, false);
+                movingCubes.erase(targetedCube);
+
+                world.setPosition(targetedCube, world.position(targetedCube) + (camera.Position - previousPos));
+                // Velocity is per second, the cube keeps the camera's speed when it's let go.
+                world.setVelocity(targetedCube, deltaTime > 0.0f ? (camera.Position - previousPos) / deltaTime : glm::vec3(0.0f));
+            }
+            prevHeld = true;
+        } else {
+            if (prevHeld && prevTargetedCube) {
+                if (world.hasFlag(prevTargetedCube, CUBE_MOVABLE)) {
+                    world.setFlag(prevTargetedCube, CUBE_MOVING, true);
+                    world.setVelocity(prevTargetedCube, world.velocity(prevTargetedCube) + calculateAngularVelocity(prevFront, camera.Front, input.time - lastMouseMov));
+                    movingCubes.insert(prevTargetedCube);
+                }
+            }
+            prevHeld = false;
+        }
+    }
+
+    // Arcane ChatGPT-written function that figures out the angular velocity the cube should be launched at after rotation. Understand and rewrite later.
+    glm::vec3 calculateAngularVelocity(glm::vec3 prevFront, glm::vec3 front, float mouseMovDelay) {
+        // --- compute exact angular velocity (world-space) from cameraToCube -> rotated ---
+        const float EPS = 1e-6f;
+        const float dt = static_cast<float>(deltaTime); // make sure this is > 0
+
+        // guard: if dt is zero, we can't compute omega
+        if (dt <= 0.0f) {
+            // handle appropriately (skip or set zero)
+            return glm::vec3(0.0f);
+        }
+        else {
+            // normalize directions for robust axis/angle extraction
+            glm::vec3 v = glm::normalize(prevFront);
+            glm::vec3 v2 = glm::normalize(front);
+
+            // cross and dot
+            glm::vec3 c = glm::cross(v, v2);
+            float s = glm::length(c);            // sin(theta)
+            float d = glm::clamp(glm::dot(v, v2), -1.0f, 1.0f); // cos(theta), clamped for safety
+
+            // angle in radians (robust for all ranges)
+            float angle = std::atan2(s, d); // angle ∈ [0, π]
+
+            glm::vec3 axis(0.0f);
+            if (s > EPS) {
+                // normal case: well-defined axis
+                axis = c / s; // normalized cross
+            }
+            else {
+                // s ~ 0 -> either no rotation or 180-degree rotation
+                if (d > 0.0f) {
+                    // vectors are nearly identical => no rotation
+                    axis = glm::vec3(0.0f); // omega will be zero below
+                    angle = 0.0f;
+                }
+                else {
+                    // vectors are opposite (angle ≈ π). Need any axis orthogonal to v.
+                    // try camera.Right (already available) unless it's parallel to v.
+                    axis = glm::cross(v, camera.Right);
+                    if (glm::dot(axis, axis) < EPS) {
+                        // camera.Right was colinear with v; fall back to world up
+                        axis = glm::cross(v, glm::vec3(0.0f, 1.0f, 0.0f));
+                        if (glm::dot(axis, axis) < EPS) {
+                            // edge case: v is vertical; pick arbitrary orthogonal axis
+                            axis = glm::cross(v, glm::vec3(1.0f, 0.0f, 0.0f));
+                        }
+                    }
+                    axis = glm::normalize(axis);
+                    // angle already ≈ π from atan2(s,d) (s ≈ 0, d ≈ -1 -> atan2(0,-1) -> π)
+                    angle = glm::pi<float>();
+                }
+            }
+
+            // angular velocity vector (rad/s)
+            glm::vec3 omega = (angle == 0.0f) ? glm::vec3(0.0f) : (axis * (angle / mouseMovDelay));
+
+            // r: vector from player's rotation center to object (world-space)
+            glm::vec3 r = world.position(prevTargetedCube) - camera.Position; // same as 'rotated' but keep for clarity
+
+            // compute release velocity
+            // The 0.005 was tuned per frame at the old ~50 fps cap, times 50 to get units per second.
+            return glm::cross(omega*0.25f, r);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+#include <string>
+#include <map>
+#include <tuple>
+#include <iostream>
+#include <vector>
+#include "stb_image.h"
+#include "AsyncAssetLoader.h"
+
+// How a texture is sampled. Two requests for the same file with different settings need separate GL textures, so this is part of the cache key.
+// The defaults are GL's own defaults, which is what the cube textures have always been sampled with.
+struct SamplerSettings {
+    GLint wrapS = GL_REPEAT;
+    GLint wrapT = GL_REPEAT;
+    GLint minFilter = GL_NEAREST_MIPMAP_LINEAR;
+    GLint magFilter = GL_LINEAR;
+    bool mipmaps = true;
+    bool flipVertically = true;
+
+    bool operator<(const SamplerSettings& o) const {
+        return std::tie(wrapS, wrapT, minFilter, magFilter, mipmaps, flipVertically) <
+            std::tie(o.wrapS, o.wrapT, o.minFilter, o.magFilter, o.mipmaps, o.flipVertically);
+    }
+};
+
+/* Reference counted cache of GL textures keyed by file path and sampler settings. Every user of the same image gets the same
+*  GL texture, so each file is only decoded and uploaded once no matter how many cubes use it. acquire() hands out a texture and
+*  bumps its count, release() gives it back and deletes the texture once nobody uses it anymore.
+*  When constructed with an AsyncAssetLoader, acquire() returns immediately with a placeholder texture and the same texture name
+*  receives the real image in a later update(), so users never have to rebind anything.
+*/
+class TextureCache
+{
+private:
+    struct Key {
+        std::string path;
+        SamplerSettings sampler;
+
+        bool operator<(const Key& o) const {
+            if (path != o.path)
+                return path < o.path;
+            return sampler < o.sampler;
+        }
+    };
+
+    struct Entry {
+        unsigned int ID;
+        int refCount;
+        size_t bytes;
+        // Id of the outstanding async decode for this texture, 0 once the real image is uploaded.
+        unsigned int request;
+    };
+
+    std::map<Key, Entry> entries;
+
+    // Optional, when set images are decoded on its worker threads and a placeholder is shown until update() uploads them.
+    AsyncAssetLoader* loader;
+    std::vector<DecodedImage> decoded;
+    unsigned int lastRequest{};
+
+    // Uploads decoded pixels into the currently bound texture. Returns the number of bytes the texture occupies in VRAM.
+    static size_t upload(const SamplerSettings& sampler, const unsigned char* data, int width, int height, int nrChannels) {
+        GLenum format = nrChannels == 1 ? GL_RED : (nrChannels == 4 ? GL_RGBA : GL_RGB);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        size_t bytes = (size_t)width * height * nrChannels;
+        if (sampler.mipmaps) {
+            glGenerateMipmap(GL_TEXTURE_2D);
+            // Each mip level is a quarter of the previous one, count them all.
+            for (int w = width / 2, h = height / 2; w > 0 || h > 0; w /= 2, h /= 2)
+                bytes += (size_t)(w > 0 ? w : 1) * (h > 0 ? h : 1) * nrChannels;
+        }
+        return bytes;
+    }
+
+    // Creates a new GL texture for the key. Without a loader the file is decoded right here, with one the texture gets a
+    // 1x1 grey placeholder and the real image is filled in by update() later on. Returns the bytes resident right now.
+    size_t load(const Key& key, unsigned int& texture, unsigned int& request) {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, key.sampler.wrapS);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, key.sampler.wrapT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, key.sampler.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, key.sampler.magFilter);
+
+        if (loader) {
+            const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+            upload(key.sampler, placeholder, 1, 1, 3);
+            // Tag the request with our own id rather than the texture name, GL may hand out a released name again before the decode finishes.
+            request = ++lastRequest;
+            loader->request(key.path, key.sampler.flipVertically, request);
+            pending++;
+            return 0;
+        }
+
+        int width, height, nrChannels;
+        stbi_set_flip_vertically_on_load(key.sampler.flipVertically);
+        size_t bytes = 0;
+        unsigned char* data = stbi_load(key.path.c_str(), &width, &height, &nrChannels, 0);
+        if (data)
+        {
+            bytes = upload(key.sampler, data, width, height, nrChannels);
+        }
+        else
+        {
+            std::cout << "Failed to load texture " << key.path << std::endl;
+        }
+        stbi_image_free(data);
+        return bytes;
+    }
+
+public:
+    // Statistics, a hit is an acquire() that didn't have to decode anything.
+    unsigned int hits{};
+    unsigned int misses{};
+    size_t residentBytes{};
+    // Textures still showing the placeholder because their image is being decoded in the background.
+    unsigned int pending{};
+
+    TextureCache(AsyncAssetLoader* asyncLoader = nullptr) : loader(asyncLoader) {}
+
+    // Textures somebody never released are deleted here, so this too has to go before the GL context.
+    ~TextureCache() {
+        for (auto& entry : entries)
+            glDeleteTextures(1, &entry.second.ID);
+    }
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    unsigned int acquire(const std::string& path, const SamplerSettings& sampler = SamplerSettings()) {
+        Key key{ path, sampler };
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            hits++;
+            it->second.refCount++;
+            return it->second.ID;
+        }
+
+        misses++;
+        Entry entry{};
+        entry.refCount = 1;
+        entry.bytes = load(key, entry.ID, entry.request);
+        residentBytes += entry.bytes;
+        entries.emplace(key, entry);
+        return entry.ID;
+    }
+
+    // Gives back a texture obtained from acquire(). The GL texture is deleted when the last user releases it.
+    void release(unsigned int texture) {
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->second.ID != texture)
+                continue;
+            if (--it->second.refCount == 0) {
+                glDeleteTextures(1, &it->second.ID);
+                residentBytes -= it->second.bytes;
+                entries.erase(it);
+            }
+            return;
+        }
+    }
+
+    // Uploads every image the async loader finished since the last call, has to be called from the GL thread (once per frame).
+    // Returns the number of textures that got their real image.
+    unsigned int update() {
+        if (!loader || pending == 0)
+            return 0;
+
+        decoded.clear();
+        loader->collect(decoded);
+        unsigned int uploaded = 0;
+        for (DecodedImage& image : decoded) {
+            pending--;
+            // The texture might have been released while its image was still being decoded.
+            Entry* entry = nullptr;
+            const Key* key = nullptr;
+            for (auto& e : entries) {
+                if (e.second.request == image.tag) {
+                    entry = &e.second;
+                    key = &e.first;
+                    break;
+                }
+            }
+            if (entry && image.data) {
+                entry->request = 0;
+                glBindTexture(GL_TEXTURE_2D, entry->ID);
+                entry->bytes = upload(key->sampler, image.data, image.width, image.height, image.channels);
+                residentBytes += entry->bytes;
+                uploaded++;
+            }
+            else if (entry) {
+                entry->request = 0;
+                std::cout << "Failed to load texture " << image.path << std::endl;
+            }
+            AsyncAssetLoader::freeImage(image);
+        }
+        return uploaded;
+    }
+
+    // Number of distinct GL textures currently alive.
+    size_t size() const {
+        return entries.size();
+    }
+
+    void printStats() const {
+        std::cout << "TextureCache: " << entries.size() << " textures (" << pending << " pending), " << hits << " hits, " << misses << " misses, "
+            << residentBytes / 1024 << " KiB resident" << std::endl;
+    }
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+// How a mesh's vertices are stored on the GPU. FLOAT_VERTICES is position, normal and uv as 8 floats (32 bytes),
+// COMPACT_VERTICES is CompactVertex (16 bytes).
+enum VertexFormat {
+    FLOAT_VERTICES,
+    COMPACT_VERTICES
+};
+
+/* Half the size of the float layout, and plenty for meshes like the cube: positions as 16 bit signed normalized integers, the
+*  normal as 10 bits per component packed into one 32 bit word (GL_INT_2_10_10_10_REV), and uvs as 16 bit unsigned normalized
+*  integers. The GPU turns them back into floats when fetching, so the shaders don't change. Positions have to be within [-1, 1] and
+*  uvs within [0, 1], a step is 1/32767 for positions, 1/511 for normals and 1/65535 for uvs.
+*/
+struct CompactVertex {
+    // w is padding, it keeps the normal 4 byte aligned.
+    int16_t position[4];
+    uint32_t normal;
+    uint16_t uv[2];
+};
+
+inline int16_t packSnorm16(float v) {
+    return (int16_t)std::lround(std::min(std::max(v, -1.0f), 1.0f) * 32767.0f);
+}
+
+inline uint16_t packUnorm16(float v) {
+    return (uint16_t)std::lround(std::min(std::max(v, 0.0f), 1.0f) * 65535.0f);
+}
+
+// x in bits 0 to 9, y in 10 to 19, z in 20 to 29, each a two's complement snorm10. The 2 bit w is left 0.
+inline uint32_t packNormal1010102(float x, float y, float z) {
+    auto pack = [](float v) {
+        return (uint32_t)(std::lround(std::min(std::max(v, -1.0f), 1.0f) * 511.0f) & 0x3FF);
+    };
+    return pack(x) | pack(y) << 10 | pack(z) << 20;
+}
+
+// Converts count vertices of 8 floats each (position, normal, uv, like cubeVertices) to the compact format. Positions are multiplied
+// by positionScale first, so a mesh can be stretched to use the whole snorm range (and have whoever draws it scale it back).
+inline std::vector<CompactVertex> packVertices(const float* vertices, int count, float positionScale = 1.0f) {
+    std::vector<CompactVertex> packed(count);
+    for (int i = 0; i < count; i++) {
+        const float* v = vertices + i * 8;
+        CompactVertex& out = packed[i];
+        out.position[0] = packSnorm16(v[0] * positionScale);
+        out.position[1] = packSnorm16(v[1] * positionScale);
+        out.position[2] = packSnorm16(v[2] * positionScale);
+        out.position[3] = 0;
+        out.normal = packNormal1010102(v[3], v[4], v[5]);
+        out.uv[0] = packUnorm16(v[6]);
+        out.uv[1] = packUnorm16(v[7]);
+    }
+    return packed;
+}
+
+#endif